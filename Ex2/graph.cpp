@@ -1,24 +1,91 @@
+#include <cassert>
 #include <iostream>
 #include <vector>
-#include <stack>
+#include <cstdint>
 #include <algorithm>
 
 class Graph {
 private:
-    std::vector<std::vector<int>> adj;
     int V;
+    // Edges are collected here by addEdge() and packed into CSR form by freeze()
+    std::vector<std::pair<int, int>> edgeList;
+    // CSR adjacency: the neighbors of v are targets[offsets[v] .. offsets[v + 1])
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edgeIds; // edgeIds[i] is the index in edgeList of half-edge i
+    bool frozen = false; // CSR arrays match edgeList
+
+    void ensureFrozen() {
+        if (!frozen)
+            freeze();
+    }
 public:
-    Graph(int V) : V(V), adj(V) {}
+    struct NeighborRange {
+        const int* first;
+        const int* last;
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+    Graph(int V) : V(V), offsets(V + 1, 0) {}
 
     void addEdge(int u, int v) {
-        adj[u].push_back(v);
-        adj[v].push_back(u); // undirected
+        edgeList.emplace_back(u, v); // undirected, both directions stored by freeze()
+        frozen = false;
+    }
+
+    // Builds the frozen CSR arrays from the edge list. The algorithms below
+    // call it on first use after an addEdge(); call it directly to keep the
+    // neighbor lists in insertion order.
+    void freeze(bool sortNeighbors = true) {
+        offsets.assign(V + 1, 0);
+        for (const auto& e : edgeList) {
+            ++offsets[e.first + 1];
+            ++offsets[e.second + 1];
+        }
+        for (int i = 0; i < V; ++i)
+            offsets[i + 1] += offsets[i];
+
+        // Half-edges are packed as (target << 32 | edge id) so that sorting a
+        // vertex's neighbors carries the edge ids along
+        std::vector<uint64_t> packed(offsets[V]);
+        std::vector<int> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t id = 0; id < edgeList.size(); ++id) {
+            const auto& e = edgeList[id];
+            packed[pos[e.first]++] = (uint64_t)e.second << 32 | id;
+            packed[pos[e.second]++] = (uint64_t)e.first << 32 | id;
+        }
+
+        if (sortNeighbors)
+            for (int v = 0; v < V; ++v)
+                std::sort(packed.begin() + offsets[v], packed.begin() + offsets[v + 1]);
+
+        targets.resize(packed.size());
+        edgeIds.resize(packed.size());
+        for (size_t i = 0; i < packed.size(); ++i) {
+            targets[i] = (int)(packed[i] >> 32);
+            edgeIds[i] = (int)(uint32_t)packed[i];
+        }
+        frozen = true;
+    }
+
+    NeighborRange neighbors(int v) const {
+        assert(frozen);
+        return {targets.data() + offsets[v], targets.data() + offsets[v + 1]};
+    }
+
+    int degree(int v) const {
+        assert(frozen);
+        return offsets[v + 1] - offsets[v];
     }
 
-    void printGraph() const {
+    void printGraph() {
+        ensureFrozen();
         for (int i = 0; i < V; ++i) {
             std::cout << i << " -> ";
-            for (int neighbor : adj[i]) {
+            for (int neighbor : neighbors(i)) {
                 std::cout << neighbor << " ";
             }
             std::cout << std::endl;
@@ -26,70 +93,121 @@ public:
     }
 
     bool isEulerianCircuitPossible() {
+        ensureFrozen();
         for (int i = 0; i < V; ++i) {
-            if (adj[i].size() % 2 != 0)
+            if (degree(i) % 2 != 0)
                 return false; // odd degree
         }
         return isConnected(); // and connected
     }
 
+    // Reusable traversal buffers, one set per thread. Visited marks are epoch
+    // stamps, so begin() starts a fresh traversal without clearing V flags.
+    struct Traversal {
+        std::vector<unsigned> mark;
+        unsigned epoch = 0;
+        std::vector<int> stack;
+
+        void begin(int V) {
+            if (mark.size() < (size_t)V) {
+                mark.assign(V, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0) {
+                std::fill(mark.begin(), mark.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool visited(int v) const { return mark[v] == epoch; }
+        void visit(int v) { mark[v] = epoch; }
+    };
+
+    static Traversal& traversal() {
+        thread_local Traversal t;
+        return t;
+    }
+
+    // Iterative DFS from start over vertices not yet visited in the current
+    // epoch of t; calls visit(v) once for every vertex reached
+    template <typename Visit>
+    void dfs(int start, Traversal& t, Visit visit) const {
+        t.stack.clear();
+        t.stack.push_back(start);
+        t.visit(start);
+        while (!t.stack.empty()) {
+            int v = t.stack.back();
+            t.stack.pop_back();
+            visit(v);
+            for (int u : neighbors(v)) {
+                if (!t.visited(u)) {
+                    t.visit(u);
+                    t.stack.push_back(u);
+                }
+            }
+        }
+    }
+
     bool isConnected() {
-        std::vector<bool> visited(V, false);
+        ensureFrozen();
         int start = -1;
 
         // Find non-zero degree vertex
         for (int i = 0; i < V; ++i) {
-            if (!adj[i].empty()) {
+            if (degree(i) > 0) {
                 start = i;
                 break;
             }
         }
         if (start == -1) return true; // No edges
 
-        dfs(start, visited);
+        Traversal& t = traversal();
+        t.begin(V);
+        dfs(start, t, [](int) {});
 
         for (int i = 0; i < V; ++i) {
-            if (!visited[i] && !adj[i].empty())
+            if (!t.visited(i) && degree(i) > 0)
                 return false;
         }
         return true;
     }
 
-    void dfs(int v, std::vector<bool>& visited) {
-        visited[v] = true;
-        for (int u : adj[v]) {
-            if (!visited[u])
-                dfs(u, visited);
-        }
-    }
-
     std::vector<int> findEulerianCircuit() {
         std::vector<int> circuit;
-        if (!isEulerianCircuitPossible()) {
+        ensureFrozen();
+        if (V == 0 || !isEulerianCircuitPossible()) {
             std::cout << "Eulerian Circuit does not exist.\n";
             return circuit;
         }
 
-        std::vector<std::vector<int>> tempAdj = adj; // Copy
-        std::stack<int> currPath;
+        // Hierholzer over edge ids: each vertex keeps a cursor into its CSR
+        // range and skips edges already walked from the other endpoint, so the
+        // whole circuit is one O(V + E) pass without copying the graph
+        std::vector<bool> used(edgeList.size(), false);
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        std::vector<int> currPath;
         std::vector<int> circuitResult;
+        circuitResult.reserve(edgeList.size() + 1);
 
-        currPath.push(0); // Start from vertex 0
+        int start = 0; // Start from a vertex that has edges
+        for (int v = 0; v < V; ++v) {
+            if (degree(v) > 0) {
+                start = v;
+                break;
+            }
+        }
+        currPath.push_back(start);
 
         while (!currPath.empty()) {
-            int v = currPath.top();
-            if (!tempAdj[v].empty()) {
-                int u = tempAdj[v].back();
-                tempAdj[v].pop_back();
-
-                // Remove reverse edge
-                auto& revList = tempAdj[u];
-                revList.erase(std::find(revList.begin(), revList.end(), v));
-
-                currPath.push(u);
+            int v = currPath.back();
+            int& i = cursor[v];
+            while (i < offsets[v + 1] && used[edgeIds[i]])
+                ++i;
+            if (i < offsets[v + 1]) {
+                used[edgeIds[i]] = true;
+                currPath.push_back(targets[i++]);
             } else {
                 circuitResult.push_back(v);
-                currPath.pop();
+                currPath.pop_back();
             }
         }
 
@@ -7,6 +7,40 @@
 
 #define PORT 8080
 
+// Reads exactly len bytes; false if the connection ends first
+bool readFull(int sock, void *buf, size_t len)
+{
+    char *p = static_cast<char *>(buf);
+    while (len > 0)
+    {
+        ssize_t n = read(sock, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Writes all len bytes, resuming after short writes
+bool sendAll(int sock, const void *buf, size_t len)
+{
+    const char *p = static_cast<const char *>(buf);
+    while (len > 0)
+    {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
 int main()
 {
     int sock = 0;
@@ -33,19 +67,24 @@ int main()
         std::cin >> seed;
         int data[3] = {V, E, seed};
 
-        send(sock, data, sizeof(data), 0);
-
         int size = 0;
-        read(sock, &size, sizeof(size));
-
-        if (size == 0)
+        if (!sendAll(sock, data, sizeof(data)) || !readFull(sock, &size, sizeof(size)) || size < 0)
+        {
+            std::cerr << "Failed to read response size.\n";
+        }
+        else if (size == 0)
         {
             std::cout << "No Eulerian Circuit found.\n";
         }
         else
         {
             std::vector<int> circuit(size);
-            read(sock, circuit.data(), size * sizeof(int));
+            if (!readFull(sock, circuit.data(), size * sizeof(int)))
+            {
+                std::cerr << "Incomplete message received.\n";
+                close(sock);
+                return 1;
+            }
             std::cout << "Eulerian Circuit: ";
             for (int v : circuit)
                 std::cout << v << " ";
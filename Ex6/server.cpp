@@ -4,80 +4,199 @@
 #include <unistd.h>
 #include <cstring>
 #include <vector>
-#include <stack>
-#include <set>
+#include <cstdint>
+#include <cmath>
 #include <random>
 #include <algorithm>
 #include <arpa/inet.h>
+#include <queue>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #define PORT 8080
 
 class Graph {
     int V;
-    std::vector<std::vector<int>> adj;
-
+    // Edges are collected here by addEdge() and packed into CSR form by freeze()
+    std::vector<std::pair<int, int>> edgeList;
+    // CSR adjacency: the neighbors of v are targets[offsets[v] .. offsets[v + 1])
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edgeIds; // edgeIds[i] is the index in edgeList of half-edge i
 public:
-    Graph(int V) : V(V), adj(V) {}
+    struct NeighborRange {
+        const int* first;
+        const int* last;
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+    Graph(int V) : V(V), offsets(V + 1, 0) {}
 
     void addEdge(int u, int v) {
-        adj[u].push_back(v);
-        adj[v].push_back(u);
+        edgeList.emplace_back(u, v); // undirected, both directions stored by freeze()
+    }
+
+    void reserveEdges(size_t count) {
+        edgeList.reserve(count);
+    }
+
+    // Builds the frozen CSR arrays from the edge list. Call once after the
+    // last addEdge(); every algorithm below reads only the CSR arrays.
+    void freeze(bool sortNeighbors = true) {
+        offsets.assign(V + 1, 0);
+        for (const auto& e : edgeList) {
+            ++offsets[e.first + 1];
+            ++offsets[e.second + 1];
+        }
+        for (int i = 0; i < V; ++i)
+            offsets[i + 1] += offsets[i];
+
+        // Half-edges are packed as (target << 32 | edge id) so that sorting a
+        // vertex's neighbors carries the edge ids along
+        std::vector<uint64_t> packed(offsets[V]);
+        std::vector<int> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t id = 0; id < edgeList.size(); ++id) {
+            const auto& e = edgeList[id];
+            packed[pos[e.first]++] = (uint64_t)e.second << 32 | id;
+            packed[pos[e.second]++] = (uint64_t)e.first << 32 | id;
+        }
+
+        if (sortNeighbors)
+            for (int v = 0; v < V; ++v)
+                std::sort(packed.begin() + offsets[v], packed.begin() + offsets[v + 1]);
+
+        targets.resize(packed.size());
+        edgeIds.resize(packed.size());
+        for (size_t i = 0; i < packed.size(); ++i) {
+            targets[i] = (int)(packed[i] >> 32);
+            edgeIds[i] = (int)(uint32_t)packed[i];
+        }
+    }
+
+    NeighborRange neighbors(int v) const {
+        return {targets.data() + offsets[v], targets.data() + offsets[v + 1]};
+    }
+
+    int degree(int v) const {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    // Reusable traversal buffers, one set per thread. Visited marks are epoch
+    // stamps, so begin() starts a fresh traversal without clearing V flags.
+    struct Traversal {
+        std::vector<unsigned> mark;
+        unsigned epoch = 0;
+        std::vector<int> stack;
+
+        void begin(int V) {
+            if (mark.size() < (size_t)V) {
+                mark.assign(V, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0) {
+                std::fill(mark.begin(), mark.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool visited(int v) const { return mark[v] == epoch; }
+        void visit(int v) { mark[v] = epoch; }
+    };
+
+    static Traversal& traversal() {
+        thread_local Traversal t;
+        return t;
+    }
+
+    // Iterative DFS from start over vertices not yet visited in the current
+    // epoch of t; calls visit(v) once for every vertex reached
+    template <typename Visit>
+    void dfs(int start, Traversal& t, Visit visit) const {
+        t.stack.clear();
+        t.stack.push_back(start);
+        t.visit(start);
+        while (!t.stack.empty()) {
+            int v = t.stack.back();
+            t.stack.pop_back();
+            visit(v);
+            for (int u : neighbors(v)) {
+                if (!t.visited(u)) {
+                    t.visit(u);
+                    t.stack.push_back(u);
+                }
+            }
+        }
     }
 
     bool isConnected() {
-        std::vector<bool> visited(V, false);
         int start = -1;
         for (int i = 0; i < V; ++i) {
-            if (!adj[i].empty()) {
+            if (degree(i) > 0) {
                 start = i;
                 break;
             }
         }
         if (start == -1) return true;
-        dfs(start, visited);
+        Traversal& t = traversal();
+        t.begin(V);
+        dfs(start, t, [](int) {});
         for (int i = 0; i < V; ++i) {
-            if (!visited[i] && !adj[i].empty())
+            if (!t.visited(i) && degree(i) > 0)
                 return false;
         }
         return true;
     }
 
-    void dfs(int v, std::vector<bool>& visited) {
-        visited[v] = true;
-        for (int u : adj[v]) {
-            if (!visited[u])
-                dfs(u, visited);
-        }
-    }
-
     bool isEulerianCircuitPossible() {
         for (int i = 0; i < V; ++i)
-            if (adj[i].size() % 2 != 0)
+            if (degree(i) % 2 != 0)
                 return false;
         return isConnected();
     }
 
     std::vector<int> findEulerianCircuit() {
         std::vector<int> circuit;
-        if (!isEulerianCircuitPossible())
+        if (V == 0 || !isEulerianCircuitPossible())
             return circuit;
 
-        std::vector<std::vector<int>> tempAdj = adj;
-        std::stack<int> currPath;
+        // Hierholzer over edge ids: each vertex keeps a cursor into its CSR
+        // range and skips edges already walked from the other endpoint, so the
+        // whole circuit is one O(V + E) pass without copying the graph
+        std::vector<bool> used(edgeList.size(), false);
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        std::vector<int> currPath;
         std::vector<int> circuitResult;
+        circuitResult.reserve(edgeList.size() + 1);
+
+        int start = 0; // Start from a vertex that has edges
+        for (int v = 0; v < V; ++v) {
+            if (degree(v) > 0) {
+                start = v;
+                break;
+            }
+        }
+        currPath.push_back(start);
 
-        currPath.push(0);
         while (!currPath.empty()) {
-            int v = currPath.top();
-            if (!tempAdj[v].empty()) {
-                int u = tempAdj[v].back();
-                tempAdj[v].pop_back();
-                auto& revList = tempAdj[u];
-                revList.erase(std::find(revList.begin(), revList.end(), v));
-                currPath.push(u);
+            int v = currPath.back();
+            int& i = cursor[v];
+            while (i < offsets[v + 1] && used[edgeIds[i]])
+                ++i;
+            if (i < offsets[v + 1]) {
+                used[edgeIds[i]] = true;
+                currPath.push_back(targets[i++]);
             } else {
                 circuitResult.push_back(v);
-                currPath.pop();
+                currPath.pop_back();
             }
         }
         std::reverse(circuitResult.begin(), circuitResult.end());
@@ -85,55 +204,401 @@ public:
     }
 };
 
-int main() {
-    int server_fd, new_socket;
-    struct sockaddr_in address;
-    int addrlen = sizeof(address);
 
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    address.sin_family = AF_INET;
-    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
-    address.sin_port = htons(PORT);
-    bind(server_fd, (struct sockaddr*)&address, sizeof(address));
-    listen(server_fd, 3);
+// Builds a simple undirected graph with exactly E distinct edges, reproducible
+// for a given seed. Vertex pairs u < v are numbered k = v * (v - 1) / 2 + u and
+// E of those indices are drawn without replacement (Floyd's algorithm), so no
+// draw is ever rejected. Above 50% density the missing pairs are drawn instead
+// and every other pair is emitted in one sweep.
+class GraphGenerator {
+    // Open-addressing set of pair indices, sized once for the whole sample
+    class IndexSet {
+        std::vector<long long> slots;
+        size_t mask;
 
-    std::cout << "Server listening on port " << PORT << "...\n";
+    public:
+        explicit IndexSet(size_t expected) {
+            size_t cap = 16;
+            while (cap < expected * 2)
+                cap <<= 1;
+            slots.assign(cap, -1);
+            mask = cap - 1;
+        }
 
-    while (true) {
-        new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen);
-        if (new_socket < 0) continue;
+        // Returns false if k was already present
+        bool insert(long long k) {
+            size_t i = (size_t)(k * 0x9E3779B97F4A7C15ULL) & mask;
+            while (slots[i] != -1) {
+                if (slots[i] == k)
+                    return false;
+                i = (i + 1) & mask;
+            }
+            slots[i] = k;
+            return true;
+        }
+    };
 
-        std::cout << "Client connected from "
-            << inet_ntoa(address.sin_addr)
-            << ":" << ntohs(address.sin_port) << std::endl;
+    static std::vector<long long> sampleIndices(long long total, long long count, std::mt19937& rng) {
+        std::vector<long long> picked;
+        picked.reserve(count);
+        IndexSet seen(count);
+        for (long long j = total - count; j < total; ++j) {
+            long long t = std::uniform_int_distribution<long long>(0, j)(rng);
+            if (!seen.insert(t)) {
+                t = j;
+                seen.insert(t);
+            }
+            picked.push_back(t);
+        }
+        return picked;
+    }
 
-        int data[3]; // V, E, seed
-        read(new_socket, data, sizeof(data));
-        int V = data[0], E = data[1], seed = data[2];
+    static std::pair<int, int> decodePair(long long k) {
+        long long v = (long long)((1.0 + std::sqrt(1.0 + 8.0 * (double)k)) / 2.0);
+        while (v * (v - 1) / 2 > k)
+            --v;
+        while ((v + 1) * v / 2 <= k)
+            ++v;
+        return {(int)(k - v * (v - 1) / 2), (int)v};
+    }
 
-        Graph g(V);
-        std::set<std::pair<int, int>> existing;
+public:
+    static long long maxEdges(int V) {
+        return V > 1 ? (long long)V * (V - 1) / 2 : 0;
+    }
+
+    static Graph generate(int V, int E, int seed) {
+        Graph g(std::max(V, 0));
+        long long total = maxEdges(V);
+        long long edges = std::min<long long>(std::max(E, 0), total);
         std::mt19937 rng(seed);
-        std::uniform_int_distribution<int> dist(0, V - 1);
-
-        while (existing.size() < (size_t)E) {
-            int u = dist(rng);
-            int v = dist(rng);
-            if (u == v) continue;
-            auto edge = std::minmax(u, v);
-            if (!existing.count(edge)) {
+
+        g.reserveEdges(edges);
+        if (edges <= total / 2) {
+            for (long long k : sampleIndices(total, edges, rng)) {
+                auto edge = decodePair(k);
                 g.addEdge(edge.first, edge.second);
-                existing.insert(edge);
             }
+        } else {
+            std::vector<long long> missing = sampleIndices(total, total - edges, rng);
+            std::sort(missing.begin(), missing.end());
+            size_t next = 0;
+            long long k = 0;
+            for (int v = 1; v < V; ++v) {
+                for (int u = 0; u < v; ++u, ++k) {
+                    if (next < missing.size() && missing[next] == k)
+                        ++next;
+                    else
+                        g.addEdge(u, v);
+                }
+            }
+        }
+        g.freeze();
+        return g;
+    }
+};
+
+// Fixed pool of threads that run submitted tasks in FIFO order
+class WorkerPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void loop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit WorkerPool(int count) {
+        for (int i = 0; i < count; ++i)
+            workers.emplace_back(&WorkerPool::loop, this);
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers)
+            t.join();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push(std::move(task));
+        }
+        cv.notify_one();
+    }
+};
+
+const int REQUEST_INTS = 3; // V, E, seed
+const size_t REQUEST_BYTES = REQUEST_INTS * sizeof(int);
+
+// Runs one request on a worker thread; returns the circuit length followed
+// by the circuit itself
+std::string handleRequest(const int* data) {
+    int V = data[0], E = data[1], seed = data[2];
+
+    Graph g = GraphGenerator::generate(V, E, seed);
+
+    std::vector<int> circuit = g.findEulerianCircuit();
+    int size = circuit.size();
+    std::string reply(reinterpret_cast<const char*>(&size), sizeof(size));
+    reply.append(reinterpret_cast<const char*>(circuit.data()), size * sizeof(int));
+    return reply;
+}
+
+// Single-threaded reactor: an edge-triggered epoll loop over non-blocking
+// sockets with a read and a write buffer per connection. Each connection
+// carries one request: once it is complete it goes to the worker pool, and
+// the connection closes after the reply is written. Finished replies come
+// back through `done` and an eventfd that wakes the loop.
+class EventLoop {
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t sent = 0;
+        bool busy = false;       // the request is in the pool
+        bool answered = false;   // the reply is in `out`
+        bool peerClosed = false; // the client sent EOF
+    };
+
+    struct Completion {
+        uint64_t id;
+        std::string reply;
+        bool failed;
+    };
+
+    // epoll tags; connections are numbered from FIRST_CONNECTION and never
+    // reuse an id, so a reply for a closed connection is simply dropped
+    static const uint64_t LISTEN_TAG = 0;
+    static const uint64_t WAKE_TAG = 1;
+    static const uint64_t FIRST_CONNECTION = 2;
+
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    uint64_t nextId = FIRST_CONNECTION;
+    std::unordered_map<uint64_t, Connection> connections;
+    WorkerPool pool;
+    std::mutex doneMtx;
+    std::vector<Completion> done;
+
+    static void setNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void watch(int fd, uint64_t tag, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = tag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void acceptAll() {
+        while (true) {
+            sockaddr_in addr{};
+            socklen_t len = sizeof(addr);
+            int fd = accept(listenFd, (sockaddr*)&addr, &len);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    perror("Accept failed");
+                return;
+            }
+            setNonBlocking(fd);
+
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+            std::cout << "Client connected from " << client_ip << ":" << ntohs(addr.sin_port) << std::endl;
+
+            uint64_t id = nextId++;
+            connections[id].fd = fd;
+            watch(fd, id, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
         }
+    }
 
-        std::vector<int> circuit = g.findEulerianCircuit();
-        int size = circuit.size();
-        write(new_socket, &size, sizeof(size));
-        if (size > 0)
-            write(new_socket, circuit.data(), size * sizeof(int));
-        close(new_socket);
+    void closeConnection(uint64_t id) {
+        close(connections[id].fd);
+        connections.erase(id);
     }
 
+    // Reads until the socket would block; false on a socket error
+    bool readInput(Connection& c) {
+        char buf[4096];
+        while (true) {
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n > 0)
+                c.in.append(buf, n);
+            else if (n == 0) {
+                c.peerClosed = true;
+                return true;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            else if (errno != EINTR)
+                return false;
+        }
+    }
+
+    // Writes until the buffer is empty or the socket would block (EPOLLOUT
+    // resumes it); false on a socket error
+    bool flushOutput(Connection& c) {
+        while (c.sent < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0)
+                c.sent += n;
+            else if (n < 0 && errno == EINTR)
+                continue;
+            else
+                return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        c.out.clear();
+        c.sent = 0;
+        return true;
+    }
+
+    // Worker side: runs the request and queues the reply for the loop
+    void compute(uint64_t id, const std::vector<int>& request) {
+        Completion result{id, std::string(), false};
+        try {
+            result.reply = handleRequest(request.data());
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            result.failed = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(doneMtx);
+            done.push_back(std::move(result));
+        }
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0)
+            perror("eventfd write failed");
+    }
+
+    // Hands a complete request to the pool, or closes a finished connection
+    void advance(uint64_t id) {
+        Connection& c = connections[id];
+        if (c.busy)
+            return;
+        if (c.answered) {
+            if (c.out.empty())
+                closeConnection(id);
+            return;
+        }
+        if (c.in.size() >= REQUEST_BYTES) {
+            std::vector<int> request(REQUEST_INTS);
+            memcpy(request.data(), c.in.data(), REQUEST_BYTES);
+            c.in.clear();
+            c.busy = true;
+            pool.submit([this, id, request] { compute(id, request); });
+            return;
+        }
+        if (c.peerClosed)
+            closeConnection(id);
+    }
+
+    void collectReplies() {
+        uint64_t count;
+        while (read(wakeFd, &count, sizeof(count)) > 0)
+            ;
+        std::vector<Completion> ready; {
+            std::lock_guard<std::mutex> lock(doneMtx);
+            ready.swap(done);
+        }
+        for (auto& r : ready) {
+            auto it = connections.find(r.id);
+            if (it == connections.end())
+                continue;
+            Connection& c = it->second;
+            c.busy = false;
+            c.answered = true;
+            c.out += r.reply;
+            if (r.failed || !flushOutput(c))
+                closeConnection(r.id);
+            else
+                advance(r.id);
+        }
+    }
+
+    void service(uint64_t id, uint32_t events) {
+        auto it = connections.find(id);
+        if (it == connections.end())
+            return;
+        Connection& c = it->second;
+        bool ok = !(events & EPOLLERR);
+        if (ok && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+            ok = readInput(c);
+        if (ok && (events & EPOLLOUT))
+            ok = flushOutput(c);
+        if (ok)
+            advance(id);
+        else
+            closeConnection(id);
+    }
+
+public:
+    EventLoop(int listenFd, int workers)
+        : listenFd(listenFd), epollFd(epoll_create1(0)), wakeFd(eventfd(0, EFD_NONBLOCK)), pool(workers) {
+        setNonBlocking(listenFd);
+        watch(listenFd, LISTEN_TAG, EPOLLIN | EPOLLET);
+        watch(wakeFd, WAKE_TAG, EPOLLIN | EPOLLET);
+    }
+
+    void run() {
+        epoll_event events[64];
+        while (true) {
+            int n = epoll_wait(epollFd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                perror("epoll_wait failed");
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == LISTEN_TAG)
+                    acceptAll();
+                else if (tag == WAKE_TAG)
+                    collectReplies();
+                else
+                    service(tag, events[i].events);
+            }
+        }
+    }
+};
+
+int main() {
+    int server_fd;
+    struct sockaddr_in address;
+
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    address.sin_port = htons(PORT);
+    bind(server_fd, (struct sockaddr*)&address, sizeof(address));
+    listen(server_fd, SOMAXCONN);
+
+    std::cout << "Server listening on port " << PORT << "...\n";
+
+    EventLoop loop(server_fd, std::max(1u, std::thread::hardware_concurrency()));
+    loop.run();
+
     return 0;
 }
@@ -2,13 +2,89 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <vector>
 #include <cstring>
+#include <cerrno>
+#include <cstdlib>
 
 #define PORT 8080
+#define BATCH_MARKER -1 // leads {BATCH_MARKER, jobCount}; see the server
 
-int main()
+// Reads exactly len bytes; false if the connection ends first
+bool readFull(int sock, void *buf, size_t len)
 {
+    char *p = static_cast<char *>(buf);
+    while (len > 0)
+    {
+        ssize_t n = read(sock, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Writes all len bytes, resuming after short writes
+bool sendAll(int sock, const void *buf, size_t len)
+{
+    const char *p = static_cast<const char *>(buf);
+    while (len > 0)
+    {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Sends jobs seeds (seed, seed + 1, ...) as one batch and prints every reply
+// as it arrives; false if the connection fails
+bool runBatch(int sock, int V, int E, int seed, int maxWeight, int algoCode, int jobs)
+{
+    std::vector<int> data = {BATCH_MARKER, jobs};
+    for (int i = 0; i < jobs; ++i)
+        data.insert(data.end(), {V, E, seed + i, maxWeight, algoCode});
+    if (!sendAll(sock, data.data(), data.size() * sizeof(int)))
+        return false;
+
+    for (int i = 0; i < jobs; ++i)
+    {
+        int head[2]; // job index, message size
+        if (!readFull(sock, head, sizeof(head)) || head[0] < 0 || head[0] >= jobs || head[1] <= 0)
+            return false;
+        std::string text(head[1], '\0');
+        if (!readFull(sock, &text[0], head[1]))
+            return false;
+        std::cout << "Seed " << seed + head[0] << ": " << text << "\n";
+    }
+    std::cout << "\n";
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // -n N runs every chosen algorithm on N consecutive seeds in one batch
+    int jobs = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if (opt == 'n' && atoi(optarg) > 0)
+            jobs = atoi(optarg);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-n jobs]\n";
+            return 1;
+        }
+    }
+
     int sock = 0;
     struct sockaddr_in serv_addr;
 
@@ -31,13 +107,15 @@ int main()
 
     try
     {
-        int V, E, seed, algoCode;
+        int V, E, seed, maxWeight, algoCode;
         std::cout << "Enter number of vertices: ";
         std::cin >> V;
         std::cout << "Enter number of edges: ";
         std::cin >> E;
         std::cout << "Enter seed: ";
         std::cin >> seed;
+        std::cout << "Enter max edge weight (1 for unweighted): ";
+        std::cin >> maxWeight;
         while (true)
         {
             std::cout << "Choose algorithm:\n";
@@ -46,9 +124,10 @@ int main()
             std::cout << "3 - Number of Cliques\n";
             std::cout << "4 - Strongly Connected Components\n";
             std::cout << "5 - Hamiltonian Circuit\n";
+            std::cout << "6 - Number of Maximal Cliques\n";
             std::cout << "Enter algorithm code: ";
             std::cin >> algoCode;
-            if (algoCode > 5)
+            if (algoCode > 6)
             {
                 std::cout << "Invalid algorithm code. Please try again.\n";
                 break;
@@ -58,25 +137,32 @@ int main()
                 break;
             }
 
-            int data[4] = {V, E, seed, algoCode};
-            send(sock, data, sizeof(data), 0);
+            if (jobs > 0)
+            {
+                if (!runBatch(sock, V, E, seed, maxWeight, algoCode, jobs))
+                {
+                    std::cerr << "Batch failed.\n";
+                    break;
+                }
+                continue;
+            }
 
+            int data[5] = {V, E, seed, maxWeight, algoCode};
             int msgSize = 0;
-            if (read(sock, &msgSize, sizeof(msgSize)) != sizeof(msgSize))
+            if (!sendAll(sock, data, sizeof(data)) || !readFull(sock, &msgSize, sizeof(msgSize)))
             {
                 std::cerr << "Failed to read response size.\n";
                 break;
             }
 
-            if (msgSize <= 0 || msgSize > 10000)
+            if (msgSize <= 0)
             {
                 std::cerr << "Invalid message size received.\n";
                 break;
             }
 
             std::vector<char> buffer(msgSize + 1, 0);
-            int received = read(sock, buffer.data(), msgSize);
-            if (received != msgSize)
+            if (!readFull(sock, buffer.data(), msgSize))
             {
                 std::cerr << "Incomplete message received.\n";
                 break;
@@ -5,39 +5,300 @@
 #include <unistd.h>
 #include <cstring>
 #include <vector>
-#include <stack>
-#include <set>
+#include <cstdint>
+#include <queue>
+#include <climits>
+#include <cmath>
 #include <random>
+#include <chrono>
 #include <algorithm>
 #include <arpa/inet.h>
 #include <map>
 #include <memory>
 #include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "cache.hpp"
 
 #define PORT 8080
 
+// A request's compute budget: the point in time after which long searches
+// give up and report what they have. The default one never passes.
+struct Deadline
+{
+    std::chrono::steady_clock::time_point at = std::chrono::steady_clock::time_point::max();
+
+    // ms milliseconds from now; no limit if ms <= 0
+    static Deadline in(int ms)
+    {
+        Deadline d;
+        if (ms > 0)
+            d.at = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        return d;
+    }
+
+    bool passed() const { return std::chrono::steady_clock::now() >= at; }
+};
+
+// Polls a Deadline from one search's inner loop. The clock is read only
+// every POLL_INTERVAL calls, and once the deadline has passed poll() stays
+// true so the search unwinds quickly.
+class DeadlineCheck
+{
+    static const unsigned POLL_INTERVAL = 1024;
+    const Deadline &deadline;
+    unsigned polls = 0;
+    bool passed = false;
+
+public:
+    explicit DeadlineCheck(const Deadline &deadline) : deadline(deadline) {}
+
+    bool poll()
+    {
+        if (!passed && ++polls % POLL_INTERVAL == 0)
+            passed = deadline.passed();
+        return passed;
+    }
+
+    bool timedOut() const { return passed; }
+};
+
 class Graph
 {
     int V;
+    // Edges are collected here by addEdge() and packed into CSR form by freeze()
+    std::vector<std::pair<int, int>> edgeList;
+    // CSR adjacency: the neighbors of v are targets[offsets[v] .. offsets[v + 1])
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edgeIds; // edgeIds[i] is the index in edgeList of half-edge i
+    std::vector<int> weights; // weights[id] is the weight of edgeList[id]
+    bool unitWeights = true;
+    bool sorted = false;
+    // Edge membership index built by freeze(): a bit matrix (row v starts at
+    // adjBits[v * rowWords]) up to MATRIX_MAX_V vertices, a hash of packed
+    // (u, v) keys above that
+    static const int MATRIX_MAX_V = 4096;
+    // Largest V solved by the Held-Karp bitmask DP (2^(V-1) words of memory)
+    static const int HELD_KARP_MAX_V = 24;
+    std::vector<uint64_t> adjBits;
+    size_t rowWords = 0;
+    std::vector<uint64_t> edgeKeys;
+    size_t keyMask = 0;
+
+    static uint64_t edgeKey(int u, int v)
+    {
+        return ((uint64_t)(uint32_t)u << 32) | (uint32_t)v;
+    }
+
+    static size_t keySlot(uint64_t key)
+    {
+        return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 17);
+    }
+
+    void buildEdgeIndex()
+    {
+        adjBits.clear();
+        edgeKeys.clear();
+        if (V <= MATRIX_MAX_V)
+        {
+            rowWords = ((size_t)V + 63) / 64;
+            adjBits.assign((size_t)V * rowWords, 0);
+            for (int u = 0; u < V; ++u)
+                for (int v : neighbors(u))
+                    adjBits[u * rowWords + (v >> 6)] |= 1ULL << (v & 63);
+            return;
+        }
+        size_t cap = 16;
+        while (cap < targets.size() * 2)
+            cap <<= 1;
+        keyMask = cap - 1;
+        edgeKeys.assign(cap, 0);
+        for (int u = 0; u < V; ++u)
+        {
+            for (int v : neighbors(u))
+            {
+                // Keys are stored +1 so that 0 marks an empty slot
+                uint64_t key = edgeKey(u, v) + 1;
+                size_t i = keySlot(key) & keyMask;
+                while (edgeKeys[i] != 0 && edgeKeys[i] != key)
+                    i = (i + 1) & keyMask;
+                edgeKeys[i] = key;
+            }
+        }
+    }
 
 public:
-    std::vector<std::vector<int>> adj;
+    struct NeighborRange
+    {
+        const int *first;
+        const int *last;
+        const int *begin() const { return first; }
+        const int *end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+    Graph(int V) : V(V), offsets(V + 1, 0) {}
+
+    // Largest V whose Hamiltonian circuit is found by Held-Karp
+    static int heldKarpMaxV() { return HELD_KARP_MAX_V; }
 
-    Graph(int V) : V(V), adj(V) {}
+    void addEdge(int u, int v, int w = 1)
+    {
+        edgeList.emplace_back(u, v);
+        weights.push_back(w);
+        unitWeights &= w == 1;
+    }
 
-    void addEdge(int u, int v)
+    void reserveEdges(size_t count)
     {
-        adj[u].push_back(v);
-        adj[v].push_back(u);
+        edgeList.reserve(count);
+        weights.reserve(count);
+    }
+
+    // Builds the frozen CSR arrays from the edge list. Call once after the
+    // last addEdge(); every algorithm below reads only the CSR arrays.
+    void freeze(bool sortNeighbors = true)
+    {
+        offsets.assign(V + 1, 0);
+        for (const auto &e : edgeList)
+        {
+            ++offsets[e.first + 1];
+            ++offsets[e.second + 1];
+        }
+        for (int i = 0; i < V; ++i)
+            offsets[i + 1] += offsets[i];
+
+        // Half-edges are packed as (target << 32 | edge id) so that sorting a
+        // vertex's neighbors carries the edge ids along
+        std::vector<uint64_t> packed(offsets[V]);
+        std::vector<int> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t id = 0; id < edgeList.size(); ++id)
+        {
+            const auto &e = edgeList[id];
+            packed[pos[e.first]++] = (uint64_t)e.second << 32 | id;
+            packed[pos[e.second]++] = (uint64_t)e.first << 32 | id;
+        }
+
+        sorted = sortNeighbors;
+        if (sorted)
+            for (int v = 0; v < V; ++v)
+                std::sort(packed.begin() + offsets[v], packed.begin() + offsets[v + 1]);
+
+        targets.resize(packed.size());
+        edgeIds.resize(packed.size());
+        for (size_t i = 0; i < packed.size(); ++i)
+        {
+            targets[i] = (int)(packed[i] >> 32);
+            edgeIds[i] = (int)(uint32_t)packed[i];
+        }
+        buildEdgeIndex();
+    }
+
+    NeighborRange neighbors(int v) const
+    {
+        return {targets.data() + offsets[v], targets.data() + offsets[v + 1]};
+    }
+
+    int degree(int v) const
+    {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    // O(1) edge test against the index built by freeze()
+    bool hasEdge(int u, int v) const
+    {
+        if (V <= MATRIX_MAX_V)
+            return (adjBits[u * rowWords + (v >> 6)] >> (v & 63)) & 1;
+        uint64_t key = edgeKey(u, v) + 1;
+        for (size_t i = keySlot(key) & keyMask; edgeKeys[i] != 0; i = (i + 1) & keyMask)
+            if (edgeKeys[i] == key)
+                return true;
+        return false;
+    }
+
+    // Bit row of v's neighbors, or nullptr when V is above MATRIX_MAX_V
+    const uint64_t *adjacencyRow(int v) const
+    {
+        return V <= MATRIX_MAX_V ? adjBits.data() + v * rowWords : nullptr;
+    }
+
+    // Approximate heap footprint, used as the graph's cost in the cache
+    size_t memoryBytes() const
+    {
+        return sizeof(*this) + edgeList.capacity() * sizeof(edgeList[0]) +
+               (offsets.capacity() + targets.capacity() + edgeIds.capacity() + weights.capacity()) * sizeof(int) +
+               (adjBits.capacity() + edgeKeys.capacity()) * sizeof(uint64_t);
+    }
+
+    // Reusable traversal buffers, one set per thread. Visited marks are epoch
+    // stamps, so begin() starts a fresh traversal without clearing V flags.
+    struct Traversal
+    {
+        std::vector<unsigned> mark;
+        unsigned epoch = 0;
+        std::vector<int> stack;
+
+        void begin(int V)
+        {
+            if (mark.size() < (size_t)V)
+            {
+                mark.assign(V, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0)
+            {
+                std::fill(mark.begin(), mark.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool visited(int v) const { return mark[v] == epoch; }
+        void visit(int v) { mark[v] = epoch; }
+    };
+
+    static Traversal &traversal()
+    {
+        thread_local Traversal t;
+        return t;
+    }
+
+    // Iterative DFS from start over vertices not yet visited in the current
+    // epoch of t; calls visit(v) once for every vertex reached
+    template <typename Visit>
+    void dfs(int start, Traversal &t, Visit visit) const
+    {
+        t.stack.clear();
+        t.stack.push_back(start);
+        t.visit(start);
+        while (!t.stack.empty())
+        {
+            int v = t.stack.back();
+            t.stack.pop_back();
+            visit(v);
+            for (int u : neighbors(v))
+            {
+                if (!t.visited(u))
+                {
+                    t.visit(u);
+                    t.stack.push_back(u);
+                }
+            }
+        }
     }
 
     bool isConnected()
     {
-        std::vector<bool> visited(V, false);
         int start = -1;
         for (int i = 0; i < V; ++i)
         {
-            if (!adj[i].empty())
+            if (degree(i) > 0)
             {
                 start = i;
                 break;
@@ -45,25 +306,19 @@ public:
         }
         if (start == -1)
             return true;
-        dfs(start, visited);
+        Traversal &t = traversal();
+        t.begin(V);
+        dfs(start, t, [](int) {});
         for (int i = 0; i < V; ++i)
-            if (!visited[i] && !adj[i].empty())
+            if (!t.visited(i) && degree(i) > 0)
                 return false;
         return true;
     }
 
-    void dfs(int v, std::vector<bool> &visited)
-    {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                dfs(u, visited);
-    }
-
     bool isEulerianCircuitPossible()
     {
         for (int i = 0; i < V; ++i)
-            if (adj[i].size() % 2 != 0)
+            if (degree(i) % 2 != 0)
                 return false;
         return isConnected();
     }
@@ -71,186 +326,755 @@ public:
     std::vector<int> findEulerianCircuit()
     {
         std::vector<int> circuit;
-        if (!isEulerianCircuitPossible())
+        if (V == 0 || !isEulerianCircuitPossible())
             return circuit;
-        std::vector<std::vector<int>> tempAdj = adj;
-        std::stack<int> currPath;
+        // Hierholzer over edge ids: each vertex keeps a cursor into its CSR
+        // range and skips edges already walked from the other endpoint, so the
+        // whole circuit is one O(V + E) pass without copying the graph
+        std::vector<bool> used(edgeList.size(), false);
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        std::vector<int> currPath;
         std::vector<int> circuitResult;
-        currPath.push(0);
+        circuitResult.reserve(edgeList.size() + 1);
+        int start = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            if (degree(v) > 0)
+            {
+                start = v;
+                break;
+            }
+        }
+        currPath.push_back(start);
         while (!currPath.empty())
         {
-            int v = currPath.top();
-            if (!tempAdj[v].empty())
+            int v = currPath.back();
+            int &i = cursor[v];
+            while (i < offsets[v + 1] && used[edgeIds[i]])
+                ++i;
+            if (i < offsets[v + 1])
             {
-                int u = tempAdj[v].back();
-                tempAdj[v].pop_back();
-                auto &revList = tempAdj[u];
-                revList.erase(std::find(revList.begin(), revList.end(), v));
-                currPath.push(u);
+                used[edgeIds[i]] = true;
+                currPath.push_back(targets[i++]);
             }
             else
             {
                 circuitResult.push_back(v);
-                currPath.pop();
+                currPath.pop_back();
             }
         }
         std::reverse(circuitResult.begin(), circuitResult.end());
         return circuitResult;
     }
 
-    int findMSTWeight()
+    // Sort-based Kruskal: edges packed as (weight << 32 | edge id) so one
+    // integer sort orders them by weight
+    long long kruskalMST() const
     {
-        std::vector<std::tuple<int, int, int>> edges;
-        std::vector<int> parent(V);
-        for (int u = 0; u < V; ++u)
+        std::vector<uint64_t> order(edgeList.size());
+        for (size_t id = 0; id < edgeList.size(); ++id)
+            order[id] = (uint64_t)weights[id] << 32 | id;
+        std::sort(order.begin(), order.end());
+
+        DisjointSets sets(V);
+        long long total = 0;
+        int joined = 0;
+        for (uint64_t key : order)
         {
-            for (int v : adj[u])
+            const auto &e = edgeList[(uint32_t)key];
+            if (sets.unite(e.first, e.second))
             {
-                if (u < v)
-                    edges.emplace_back(1, u, v);
+                total += (long long)(key >> 32);
+                if (++joined == V - 1)
+                    break;
             }
         }
-        std::sort(edges.begin(), edges.end());
-        std::function<int(int)> find = [&](int x)
-        {
-            return parent[x] == x ? x : parent[x] = find(parent[x]);
-        };
-        for (int i = 0; i < V; ++i)
-            parent[i] = i;
-        int mstWeight = 0;
-        for (auto [w, u, v] : edges)
+        return total;
+    }
+
+    // Heap-based Prim, restarted from every vertex not yet in the forest.
+    // Stale heap entries are skipped instead of decreasing keys.
+    long long primMST() const
+    {
+        std::vector<char> inTree(V, 0);
+        std::vector<int> best(V, INT_MAX);
+        using Entry = std::pair<int, int>; // weight, vertex
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        long long total = 0;
+        for (int s = 0; s < V; ++s)
         {
-            int ru = find(u), rv = find(v);
-            if (ru != rv)
+            if (inTree[s])
+                continue;
+            best[s] = 0;
+            heap.push({0, s});
+            while (!heap.empty())
             {
-                mstWeight += w;
-                parent[ru] = rv;
+                Entry top = heap.top();
+                heap.pop();
+                int v = top.second;
+                if (inTree[v] || top.first > best[v])
+                    continue;
+                inTree[v] = 1;
+                total += top.first;
+                for (int i = offsets[v]; i < offsets[v + 1]; ++i)
+                {
+                    int u = targets[i], w = weights[edgeIds[i]];
+                    if (!inTree[u] && w < best[u])
+                    {
+                        best[u] = w;
+                        heap.push({w, u});
+                    }
+                }
             }
         }
-        return mstWeight;
+        return total;
+    }
+
+    // Minimum spanning forest weight. With unit weights every spanning forest
+    // is minimal, so the answer is V minus the number of components and no
+    // edge is sorted. Otherwise dense graphs (a quarter or more of all vertex
+    // pairs) run Prim and the rest Kruskal.
+    long long findMSTWeight()
+    {
+        if (unitWeights)
+        {
+            int count;
+            componentLabels(count);
+            return V - count;
+        }
+        if (4 * (long long)edgeList.size() >= (long long)V * (V - 1) / 2)
+            return primMST();
+        return kruskalMST();
     }
 
-    bool isClique(const std::vector<int> &nodes)
+    // Vertices in degeneracy order (repeatedly remove a minimum-degree vertex),
+    // bucket-queue version of Batagelj-Zaversnik, O(V + E)
+    std::vector<int> degeneracyOrder() const
     {
-        for (size_t i = 0; i < nodes.size(); ++i)
+        std::vector<int> deg(V), pos(V), vert(V);
+        int maxDeg = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            deg[v] = degree(v);
+            maxDeg = std::max(maxDeg, deg[v]);
+        }
+        std::vector<int> bin(maxDeg + 1, 0);
+        for (int v = 0; v < V; ++v)
+            ++bin[deg[v]];
+        for (int d = 0, start = 0; d <= maxDeg; ++d)
+        {
+            int num = bin[d];
+            bin[d] = start;
+            start += num;
+        }
+        for (int v = 0; v < V; ++v)
+        {
+            pos[v] = bin[deg[v]]++;
+            vert[pos[v]] = v;
+        }
+        for (int d = maxDeg; d > 0; --d)
+            bin[d] = bin[d - 1];
+        bin[0] = 0;
+
+        for (int i = 0; i < V; ++i)
         {
-            for (size_t j = i + 1; j < nodes.size(); ++j)
+            int v = vert[i];
+            for (int u : neighbors(v))
             {
-                int u = nodes[i], v = nodes[j];
-                if (std::find(adj[u].begin(), adj[u].end(), v) == adj[u].end())
-                    return false;
+                if (deg[u] > deg[v])
+                {
+                    int du = deg[u], pu = pos[u], pw = bin[du], w = vert[pw];
+                    if (u != w)
+                    {
+                        pos[u] = pw;
+                        vert[pu] = w;
+                        pos[w] = pu;
+                        vert[pw] = u;
+                    }
+                    ++bin[du];
+                    --deg[u];
+                }
             }
         }
-        return true;
+        return vert;
     }
 
-    int countCliques()
+    // Bron-Kerbosch search inside one vertex's neighborhood. The k local
+    // vertices are renumbered 0..k-1 and every candidate set is a bitset of
+    // `words` words; each recursion level owns a slice of `sets`.
+    struct CliqueSearch
     {
-        int count = 0;
-        int total = 1 << V; // All subsets
+        DeadlineCheck check;
+        size_t words = 0;
+        std::vector<uint64_t> rows; // local adjacency, row i at rows[i * words]
+        std::vector<uint64_t> sets;
+
+        explicit CliqueSearch(const Deadline &deadline) : check(deadline) {}
 
-        for (int mask = 1; mask < total; ++mask)
+        void reset(const Graph &g, const std::vector<int> &local, int setsPerLevel)
         {
-            std::vector<int> subset;
-            for (int i = 0; i < V; ++i)
+            size_t k = local.size();
+            words = (k + 63) / 64;
+            rows.assign(k * words, 0);
+            for (size_t i = 0; i < k; ++i)
+                for (size_t j = i + 1; j < k; ++j)
+                    if (g.hasEdge(local[i], local[j]))
+                    {
+                        rows[i * words + (j >> 6)] |= 1ULL << (j & 63);
+                        rows[j * words + (i >> 6)] |= 1ULL << (i & 63);
+                    }
+            sets.assign((k + 2) * setsPerLevel * words, 0);
+        }
+
+        const uint64_t *row(size_t v) const { return rows.data() + v * words; }
+
+        // Every clique inside P (P is consumed; the child level follows it).
+        // Past the deadline it returns the cliques counted so far.
+        long long countAll(uint64_t *P)
+        {
+            long long total = 0;
+            uint64_t *child = P + words;
+            for (size_t w = 0; w < words; ++w)
             {
-                if (mask & (1 << i))
-                    subset.push_back(i);
+                while (P[w])
+                {
+                    if (check.poll())
+                        return total;
+                    size_t v = w * 64 + __builtin_ctzll(P[w]);
+                    P[w] &= P[w] - 1;
+                    ++total;
+                    const uint64_t *nv = row(v);
+                    bool any = false;
+                    for (size_t i = 0; i < words; ++i)
+                        any |= (child[i] = P[i] & nv[i]) != 0;
+                    if (any)
+                        total += countAll(child);
+                }
             }
-            if (isClique(subset))
-                count++;
+            return total;
         }
 
+        // Maximal cliques extending R with candidates P and excluded X, with
+        // Tomita pivoting. Level layout is P, X, then the branching set.
+        long long countMaximal(uint64_t *P)
+        {
+            if (check.poll())
+                return 0;
+            uint64_t *X = P + words, *branch = X + words, *child = branch + words;
+            bool pEmpty = true, xEmpty = true;
+            for (size_t i = 0; i < words; ++i)
+            {
+                pEmpty &= P[i] == 0;
+                xEmpty &= X[i] == 0;
+            }
+            if (pEmpty)
+                return xEmpty ? 1 : 0;
+
+            // Pivot: the vertex of P | X with the most neighbors in P
+            size_t pivot = 0;
+            int best = -1;
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t m = P[w] | X[w]; m; m &= m - 1)
+                {
+                    size_t u = w * 64 + __builtin_ctzll(m);
+                    const uint64_t *nu = row(u);
+                    int common = 0;
+                    for (size_t i = 0; i < words; ++i)
+                        common += __builtin_popcountll(P[i] & nu[i]);
+                    if (common > best)
+                    {
+                        best = common;
+                        pivot = u;
+                    }
+                }
+            }
+
+            const uint64_t *np = row(pivot);
+            for (size_t i = 0; i < words; ++i)
+                branch[i] = P[i] & ~np[i];
+
+            long long total = 0;
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t m = branch[w]; m; m &= m - 1)
+                {
+                    size_t v = w * 64 + __builtin_ctzll(m);
+                    const uint64_t *nv = row(v);
+                    for (size_t i = 0; i < words; ++i)
+                    {
+                        child[i] = P[i] & nv[i];
+                        child[words + i] = X[i] & nv[i];
+                    }
+                    total += countMaximal(child);
+                    P[w] &= ~(1ULL << (v & 63));
+                    X[w] |= 1ULL << (v & 63);
+                }
+            }
+            return total;
+        }
+    };
+
+    // Counts all non-empty cliques, or only the maximal ones. Each vertex v is
+    // the earliest member (in degeneracy order) of the cliques it roots, so
+    // the search only ever sees v's later neighbors as candidates and stays
+    // within the graph's degeneracy even when V is in the thousands.
+    // complete is false if the deadline cut the count short (a lower bound).
+    long long countCliques(const Deadline &deadline, bool &complete, bool maximalOnly = false)
+    {
+        std::vector<int> order = degeneracyOrder();
+        std::vector<int> rank(V);
+        for (int i = 0; i < V; ++i)
+            rank[order[i]] = i;
+
+        CliqueSearch search(deadline);
+        std::vector<int> local;
+        long long count = 0;
+        for (int v : order)
+        {
+            if (search.check.timedOut())
+                break;
+            local.clear();
+            for (int u : neighbors(v))
+                if (rank[u] > rank[v])
+                    local.push_back(u);
+            size_t later = local.size();
+
+            if (!maximalOnly)
+            {
+                search.reset(*this, local, 1);
+                for (size_t i = 0; i < later; ++i)
+                    search.sets[i >> 6] |= 1ULL << (i & 63);
+                count += 1 + search.countAll(search.sets.data());
+                continue;
+            }
+
+            for (int u : neighbors(v))
+                if (rank[u] < rank[v])
+                    local.push_back(u);
+            search.reset(*this, local, 3);
+            uint64_t *P = search.sets.data(), *X = P + search.words;
+            for (size_t i = 0; i < local.size(); ++i)
+                (i < later ? P : X)[i >> 6] |= 1ULL << (i & 63);
+            count += search.countMaximal(P);
+        }
+        complete = !search.check.timedOut();
         return count;
     }
-    void fillOrder(int v, std::vector<bool> &visited, std::stack<int> &Stack)
+    // Union-find with union by rank and path halving
+    struct DisjointSets
     {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                fillOrder(u, visited, Stack);
-        Stack.push(v);
+        std::vector<int> parent;
+        std::vector<unsigned char> rank;
+
+        explicit DisjointSets(int n) : parent(n), rank(n, 0)
+        {
+            for (int i = 0; i < n; ++i)
+                parent[i] = i;
+        }
+
+        int find(int x)
+        {
+            while (parent[x] != x)
+                x = parent[x] = parent[parent[x]];
+            return x;
+        }
+
+        // Returns false if a and b were already in the same set
+        bool unite(int a, int b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return false;
+            if (rank[a] < rank[b])
+                std::swap(a, b);
+            parent[b] = a;
+            if (rank[a] == rank[b])
+                ++rank[a];
+            return true;
+        }
+    };
+
+    // addEdge() stores every edge in both directions, so the strongly
+    // connected components are the connected components: one union-find pass
+    // over the edge list, no transpose and no DFS. Returns each vertex's
+    // component, numbered in order of the component's smallest vertex; count
+    // receives the number of components.
+    std::vector<int> componentLabels(int &count) const
+    {
+        DisjointSets sets(V);
+        for (const auto &e : edgeList)
+            sets.unite(e.first, e.second);
+
+        std::vector<int> label(V), rootLabel(V, -1);
+        count = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            int root = sets.find(v);
+            if (rootLabel[root] < 0)
+                rootLabel[root] = count++;
+            label[v] = rootLabel[root];
+        }
+        return label;
     }
 
-    Graph getTranspose()
+    int findSCCCount()
     {
-        Graph gT(V);
-        for (int u = 0; u < V; ++u)
-            for (int v : adj[u])
-                gT.addEdge(v, u);
-        return gT;
+        int count;
+        componentLabels(count);
+        return count;
     }
 
-    void dfsSCC(int v, std::vector<bool> &visited)
+    // A Hamiltonian circuit needs a biconnected graph: one DFS from vertex 0
+    // (iterative, with low-links) rejects disconnected graphs and graphs with
+    // an articulation point (which also covers bridges when V >= 3)
+    bool isBiconnected()
     {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                dfsSCC(u, visited);
+        std::vector<int> disc(V, -1), low(V), parent(V, -1), cursor(V, 0);
+        std::vector<int> stack;
+        int index = 0, rootChildren = 0;
+        disc[0] = low[0] = index++;
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            int v = stack.back();
+            if (cursor[v] < degree(v))
+            {
+                int u = neighbors(v).first[cursor[v]++];
+                if (disc[u] == -1)
+                {
+                    parent[u] = v;
+                    disc[u] = low[u] = index++;
+                    stack.push_back(u);
+                    if (v == 0)
+                        ++rootChildren;
+                }
+                else if (u != parent[v])
+                    low[v] = std::min(low[v], disc[u]);
+                continue;
+            }
+            stack.pop_back();
+            if (stack.empty())
+                break;
+            int p = stack.back();
+            low[p] = std::min(low[p], low[v]);
+            if (p != 0 && low[v] >= disc[p])
+                return false;
+        }
+        return index == V && rootChildren <= 1;
     }
 
-    int findSCCCount()
+    // Held-Karp over subsets of vertices 1..V-1 (bit i stands for vertex i + 1):
+    // reach[mask] holds every end vertex of a path that leaves 0 and visits
+    // exactly mask. O(2^V * V) time, 2^(V-1) words of memory.
+    std::vector<int> heldKarpCircuit(DeadlineCheck &check)
     {
-        std::stack<int> Stack;
-        std::vector<bool> visited(V, false);
+        int n = V - 1;
+        uint32_t full = (1u << n) - 1;
+        std::vector<uint32_t> adjMask(V);
+        for (int v = 0; v < V; ++v)
+            adjMask[v] = (uint32_t)(adjacencyRow(v)[0] >> 1) & full;
 
-        for (int i = 0; i < V; ++i)
-            if (!visited[i])
-                fillOrder(i, visited, Stack);
+        std::vector<uint32_t> reach(full + 1, 0);
+        for (uint32_t mask = 1; mask <= full; ++mask)
+        {
+            if (check.poll())
+                return {};
+            if ((mask & (mask - 1)) == 0)
+            {
+                reach[mask] = mask & adjMask[0];
+                continue;
+            }
+            uint32_t ends = 0;
+            for (uint32_t m = mask; m; m &= m - 1)
+            {
+                int i = __builtin_ctz(m);
+                if (reach[mask ^ (1u << i)] & adjMask[i + 1])
+                    ends |= 1u << i;
+            }
+            reach[mask] = ends;
+        }
+
+        std::vector<int> path;
+        uint32_t ends = reach[full] & adjMask[0];
+        if (ends == 0)
+            return path;
+        // Walk back from an end adjacent to 0, peeling one vertex at a time
+        int cur = __builtin_ctz(ends);
+        for (uint32_t mask = full; mask; )
+        {
+            path.push_back(cur + 1);
+            mask ^= 1u << cur;
+            if (mask)
+                cur = __builtin_ctz(reach[mask] & adjMask[cur + 1]);
+        }
+        path.push_back(0);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Search state for the backtracking engine used above HELD_KARP_MAX_V
+    struct HamiltonSearch
+    {
+        DeadlineCheck check;
+        std::vector<int> path;
+        std::vector<char> visited;
+        std::vector<int> freeDeg; // unvisited neighbors of each vertex
+        std::vector<int> queue;
+        std::vector<int> seen;
+        int stamp = 0;
 
-        Graph gr = getTranspose();
-        visited.assign(V, false);
-        int count = 0;
+        explicit HamiltonSearch(const Deadline &deadline) : check(deadline) {}
+    };
 
-        while (!Stack.empty())
+    // Every unvisited vertex must stay reachable from the path's end through
+    // unvisited vertices, or the path can never be completed
+    bool remainderConnected(HamiltonSearch &s, int end, int remaining)
+    {
+        ++s.stamp;
+        s.queue.clear();
+        s.queue.push_back(end);
+        s.seen[end] = s.stamp;
+        int reached = 0;
+        for (size_t head = 0; head < s.queue.size(); ++head)
         {
-            int v = Stack.top();
-            Stack.pop();
-            if (!visited[v])
+            for (int u : neighbors(s.queue[head]))
             {
-                gr.dfsSCC(v, visited);
-                count++;
+                if (!s.visited[u] && s.seen[u] != s.stamp)
+                {
+                    s.seen[u] = s.stamp;
+                    s.queue.push_back(u);
+                    ++reached;
+                }
             }
         }
-
-        return count;
+        return reached == remaining;
     }
 
-    bool hamiltonUtil(int pos, std::vector<int> &path, std::vector<bool> &visited)
+    // Extends path[0..pos) one vertex at a time, trying the candidates with
+    // the fewest unvisited neighbors first (Warnsdorff's rule); gives up
+    // once the deadline passes
+    bool hamiltonUtil(int pos, HamiltonSearch &s)
     {
+        if (s.check.poll())
+            return false;
+        int end = s.path[pos - 1];
         if (pos == V)
+            return hasEdge(end, s.path[0]);
+
+        std::vector<int> candidates;
+        for (int v : neighbors(end))
+            if (!s.visited[v])
+                candidates.push_back(v);
+        std::sort(candidates.begin(), candidates.end(), [&](int a, int b)
+                  { return s.freeDeg[a] < s.freeDeg[b]; });
+
+        for (int v : candidates)
+        {
+            s.path[pos] = v;
+            s.visited[v] = true;
+            for (int u : neighbors(v))
+                --s.freeDeg[u];
+
+            // 0 must keep an unvisited neighbor to close the circuit through
+            bool feasible = pos + 1 == V || s.freeDeg[s.path[0]] > 0;
+            if (feasible && end != s.path[0])
+            {
+                // end becomes interior: its unvisited neighbors lose it, and each
+                // still needs two usable neighbors (unvisited, the new end v, or 0
+                // to close the circuit)
+                for (int w : neighbors(end))
+                {
+                    if (!s.visited[w] && s.freeDeg[w] + hasEdge(w, v) + hasEdge(w, s.path[0]) < 2)
+                    {
+                        feasible = false;
+                        break;
+                    }
+                }
+            }
+            if (feasible && pos + 1 < V)
+                feasible = remainderConnected(s, v, V - pos - 1);
+            if (feasible && hamiltonUtil(pos + 1, s))
+                return true;
+
+            for (int u : neighbors(v))
+                ++s.freeDeg[u];
+            s.visited[v] = false;
+        }
+        return false;
+    }
+
+    // Hamiltonian circuit as V vertices starting at 0 (the edge back to 0 is
+    // implied), or an empty vector when there is none. Cheap necessary
+    // conditions run first, then Held-Karp for small V, then backtracking.
+    // complete is false if the deadline ended the search without an answer.
+    std::vector<int> findHamiltonianCircuit(const Deadline &deadline, bool &complete)
+    {
+        std::vector<int> none;
+        complete = true;
+        if (V < 3)
+            return none;
+        for (int v = 0; v < V; ++v)
+            if (degree(v) < 2)
+                return none;
+        if (!isBiconnected())
+            return none;
+        if (V <= HELD_KARP_MAX_V)
+        {
+            DeadlineCheck check(deadline);
+            std::vector<int> path = heldKarpCircuit(check);
+            complete = !check.timedOut();
+            return path;
+        }
+
+        HamiltonSearch s(deadline);
+        s.path.assign(V, -1);
+        s.visited.assign(V, false);
+        s.freeDeg.resize(V);
+        s.seen.assign(V, 0);
+        for (int v = 0; v < V; ++v)
+            s.freeDeg[v] = degree(v);
+        s.path[0] = 0;
+        s.visited[0] = true;
+        for (int u : neighbors(0))
+            --s.freeDeg[u];
+        if (hamiltonUtil(1, s))
+            return s.path;
+        complete = !s.check.timedOut();
+        return none;
+    }
+
+    bool hasHamiltonianCircuit(const Deadline &deadline, bool &complete)
+    {
+        return !findHamiltonianCircuit(deadline, complete).empty();
+    }
+};
+
+// Random Graph Generator
+// Builds a simple undirected graph with exactly E distinct edges, reproducible
+// for a given seed. Vertex pairs u < v are numbered k = v * (v - 1) / 2 + u and
+// E of those indices are drawn without replacement (Floyd's algorithm), so no
+// draw is ever rejected. Above 50% density the missing pairs are drawn instead
+// and every other pair is emitted in one sweep.
+class GraphGenerator
+{
+    // Open-addressing set of pair indices, sized once for the whole sample
+    class IndexSet
+    {
+        std::vector<long long> slots;
+        size_t mask;
+
+    public:
+        explicit IndexSet(size_t expected)
         {
-            return std::find(adj[path[pos - 1]].begin(), adj[path[pos - 1]].end(), path[0]) != adj[path[pos - 1]].end();
+            size_t cap = 16;
+            while (cap < expected * 2)
+                cap <<= 1;
+            slots.assign(cap, -1);
+            mask = cap - 1;
         }
 
-        for (int v = 1; v < V; ++v)
+        // Returns false if k was already present
+        bool insert(long long k)
         {
-            if (!visited[v] && std::find(adj[path[pos - 1]].begin(), adj[path[pos - 1]].end(), v) != adj[path[pos - 1]].end())
+            size_t i = (size_t)(k * 0x9E3779B97F4A7C15ULL) & mask;
+            while (slots[i] != -1)
             {
-                path[pos] = v;
-                visited[v] = true;
-                if (hamiltonUtil(pos + 1, path, visited))
-                    return true;
-                visited[v] = false;
+                if (slots[i] == k)
+                    return false;
+                i = (i + 1) & mask;
             }
+            slots[i] = k;
+            return true;
         }
-        return false;
+    };
+
+    static std::vector<long long> sampleIndices(long long total, long long count, std::mt19937 &rng)
+    {
+        std::vector<long long> picked;
+        picked.reserve(count);
+        IndexSet seen(count);
+        for (long long j = total - count; j < total; ++j)
+        {
+            long long t = std::uniform_int_distribution<long long>(0, j)(rng);
+            if (!seen.insert(t))
+            {
+                t = j;
+                seen.insert(t);
+            }
+            picked.push_back(t);
+        }
+        return picked;
+    }
+
+    static std::pair<int, int> decodePair(long long k)
+    {
+        long long v = (long long)((1.0 + std::sqrt(1.0 + 8.0 * (double)k)) / 2.0);
+        while (v * (v - 1) / 2 > k)
+            --v;
+        while ((v + 1) * v / 2 <= k)
+            ++v;
+        return {(int)(k - v * (v - 1) / 2), (int)v};
     }
 
-    bool hasHamiltonianCircuit()
+public:
+    static long long maxEdges(int V)
     {
-        std::vector<int> path(V, -1);
-        std::vector<bool> visited(V, false);
-        path[0] = 0;
-        visited[0] = true;
-        return hamiltonUtil(1, path, visited);
+        return V > 1 ? (long long)V * (V - 1) / 2 : 0;
+    }
+
+    // Weights are drawn uniformly from [1, maxWeight] after the edge set is
+    // sampled, so the same seed gives the same edges for any maxWeight
+    static Graph generate(int V, int E, int seed, int maxWeight = 1)
+    {
+        Graph g(std::max(V, 0));
+        long long total = maxEdges(V);
+        long long edges = std::min<long long>(std::max(E, 0), total);
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> weightDist(1, std::max(maxWeight, 1));
+        auto weight = [&]
+        { return maxWeight > 1 ? weightDist(rng) : 1; };
+
+        g.reserveEdges(edges);
+        if (edges <= total / 2)
+        {
+            for (long long k : sampleIndices(total, edges, rng))
+            {
+                auto edge = decodePair(k);
+                g.addEdge(edge.first, edge.second, weight());
+            }
+        }
+        else
+        {
+            std::vector<long long> missing = sampleIndices(total, total - edges, rng);
+            std::sort(missing.begin(), missing.end());
+            size_t next = 0;
+            long long k = 0;
+            for (int v = 1; v < V; ++v)
+            {
+                for (int u = 0; u < v; ++u, ++k)
+                {
+                    if (next < missing.size() && missing[next] == k)
+                        ++next;
+                    else
+                        g.addEdge(u, v, weight());
+                }
+            }
+        }
+        g.freeze();
+        return g;
     }
 };
 
-// Strategy Pattern
+// Strategy Pattern. The exponential strategies stop at the deadline, clear
+// complete and answer with what they have.
 class GraphAlgorithm
 {
 public:
+    Deadline deadline;
+    bool complete = true;
+
     virtual std::string execute(Graph &g) = 0;
     virtual ~GraphAlgorithm() {}
 };
@@ -275,7 +1099,7 @@ class MSTWeight : public GraphAlgorithm
 public:
     std::string execute(Graph &g) override
     {
-        int weight = g.findMSTWeight();
+        long long weight = g.findMSTWeight();
         return "MST weight: " + std::to_string(weight);
     }
 };
@@ -285,11 +1109,25 @@ class NumberOfCliques : public GraphAlgorithm
 public:
     std::string execute(Graph &g) override
     {
-        int count = g.countCliques();
+        long long count = g.countCliques(deadline, complete);
+        if (!complete)
+            return "Number of Cliques: at least " + std::to_string(count) + " (timed out)";
         return "Number of Cliques: " + std::to_string(count);
     }
 };
 
+class NumberOfMaximalCliques : public GraphAlgorithm
+{
+public:
+    std::string execute(Graph &g) override
+    {
+        long long count = g.countCliques(deadline, complete, true);
+        if (!complete)
+            return "Number of Maximal Cliques: at least " + std::to_string(count) + " (timed out)";
+        return "Number of Maximal Cliques: " + std::to_string(count);
+    }
+};
+
 class SCC : public GraphAlgorithm
 {
 public:
@@ -305,7 +1143,10 @@ class HamiltonianCircuit : public GraphAlgorithm
 public:
     std::string execute(Graph &g) override
     {
-        if (g.hasHamiltonianCircuit())
+        bool found = g.hasHamiltonianCircuit(deadline, complete);
+        if (!complete)
+            return "Hamiltonian Circuit search timed out";
+        if (found)
             return "Graph has a Hamiltonian Circuit";
         return "Graph does not have a Hamiltonian Circuit";
     }
@@ -315,7 +1156,55 @@ public:
 // Factory Pattern
 class AlgorithmFactory
 {
+    // Expected number of cliques in a uniform random graph with V vertices
+    // and E edges: the sum over k of C(V, k) * p^(k(k-1)/2). The terms rise
+    // then fall, so the sum stops at the first term below one past k = 2.
+    static double expectedCliques(int V, int E)
+    {
+        double pairs = (double)V * (V - 1) / 2;
+        if (V <= 0 || E <= 0 || pairs <= 0)
+            return std::max(V, 0);
+        double logP = std::log(std::min(1.0, E / pairs));
+        // log C(V, k) is built up a factor at a time: std::lgamma writes the
+        // global signgam, and the estimate runs on several threads at once
+        double total = 0, logChoose = 0;
+        for (int k = 1; k <= V; ++k)
+        {
+            logChoose += std::log((double)(V - k + 1) / k);
+            double term = std::exp(logChoose + k * (k - 1) / 2.0 * logP);
+            total += term;
+            if (term < 1 && k > 2)
+                break;
+        }
+        return total;
+    }
+
 public:
+    // Rough step count for running algorithm code on a generated graph with
+    // V vertices and E edges, generation included. It follows the engines
+    // above: the clique search visits every clique once, Held-Karp costs
+    // V * 2^(V-2), and the pruned backtracking above it is taken as V * E
+    // (its rare blow-ups are what the deadline is for).
+    static double estimateCost(int code, int V, int E)
+    {
+        double n = std::max(V, 1), m = std::max(E, 1);
+        double base = n + m;
+        switch (code)
+        {
+        case 2:
+            return base + m * std::log2(m + 1);
+        case 3:
+        case 6:
+            return base + expectedCliques(V, E);
+        case 5:
+            if (V <= Graph::heldKarpMaxV())
+                return base + std::ldexp(n, std::max(V - 2, 0));
+            return base + n * m;
+        default:
+            return base;
+        }
+    }
+
     static std::unique_ptr<GraphAlgorithm> create(int code)
     {
         switch (code)
@@ -330,16 +1219,470 @@ public:
             return std::make_unique<SCC>();
         case 5:
             return std::make_unique<HamiltonianCircuit>();
+        case 6:
+            return std::make_unique<NumberOfMaximalCliques>();
         default:
             return nullptr;
         }
     }
 };
 
-    int main() {
-        int server_fd, new_socket;
+// Fixed pool of threads that run submitted tasks in FIFO order
+class WorkerPool
+{
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void loop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]
+                        { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit WorkerPool(int count)
+    {
+        for (int i = 0; i < count; ++i)
+            workers.emplace_back(&WorkerPool::loop, this);
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push(std::move(task));
+        }
+        cv.notify_one();
+    }
+};
+
+const int REQUEST_INTS = 5; // V, E, seed, maxWeight, algoCode
+const size_t REQUEST_BYTES = REQUEST_INTS * sizeof(int);
+
+// A batch starts with {BATCH_MARKER, jobCount} (never a valid V) and is
+// followed by jobCount requests. Each job is answered as soon as it finishes,
+// as {jobIndex, len, text}, so replies of one batch arrive in any order.
+const int BATCH_MARKER = -1;
+const size_t BATCH_HEADER_BYTES = 2 * sizeof(int);
+const int MAX_BATCH_JOBS = 65536;
+
+// Generation is deterministic in (V, E, seed, maxWeight), so repeated
+// requests share one generated graph and reuse each algorithm's answer.
+// A frozen graph is only read, so workers may run algorithms on it together.
+using GraphKey = std::array<int, 4>;  // V, E, seed, maxWeight
+using ResultKey = std::array<int, 5>; // V, E, seed, maxWeight, algoCode
+const size_t GRAPH_CACHE_BYTES = 256u << 20;
+const size_t RESULT_CACHE_BYTES = 32u << 20;
+
+// Compute budget of every request in milliseconds (0 for none); timed-out
+// answers are partial and never cached
+const int DEFAULT_DEADLINE_MS = 10000;
+int deadlineMs = DEFAULT_DEADLINE_MS;
+
+// Admission by estimated cost (AlgorithmFactory::estimateCost, roughly 1e8
+// steps a second): jobs above LIGHT_COST_LIMIT run on a separate heavy pool
+// so cheap ones never queue behind them, and jobs above maxCost are
+// answered with a rejection instead of being run
+const double LIGHT_COST_LIMIT = 1e7;
+const double DEFAULT_MAX_COST = 1e11;
+double maxCost = DEFAULT_MAX_COST;
+LruCache<GraphKey, Graph, IntsHash<4>> graphCache(GRAPH_CACHE_BYTES);
+LruCache<ResultKey, const std::string, IntsHash<5>> resultCache(RESULT_CACHE_BYTES);
+
+// The graph for key, generated on a cache miss
+std::shared_ptr<Graph> cachedGraph(const GraphKey &key)
+{
+    std::shared_ptr<Graph> g = graphCache.get(key);
+    if (!g)
+    {
+        g = std::make_shared<Graph>(GraphGenerator::generate(key[0], key[1], key[2], key[3]));
+        graphCache.put(key, g, g->memoryBytes());
+    }
+    return g;
+}
+
+void printCacheStats()
+{
+    std::cout << "Cache hits/misses: graphs " << graphCache.hits() << "/" << graphCache.misses()
+              << ", results " << resultCache.hits() << "/" << resultCache.misses() << "\n";
+}
+
+// The length-prefixed reply carrying result, led by the job index for a
+// batch job (job >= 0)
+std::string frameReply(const std::string &result, int job)
+{
+    std::string reply;
+    if (job >= 0)
+        reply.append(reinterpret_cast<const char *>(&job), sizeof(job));
+    int len = result.size();
+    reply.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    return reply + result;
+}
+
+// The answer to a job whose estimated cost is over maxCost
+std::string rejection(double cost)
+{
+    char text[96];
+    snprintf(text, sizeof(text), "Rejected: estimated cost %.3g exceeds the limit %.3g", cost, maxCost);
+    return text;
+}
+
+// Runs one admitted request on a worker thread and returns its reply
+std::string handleRequest(const int *data, int job = -1)
+{
+    int V = data[0], E = data[1], seed = data[2], maxWeight = data[3], algoCode = data[4];
+
+    ResultKey key{V, E, seed, maxWeight, algoCode};
+    std::shared_ptr<const std::string> cached;
+    std::string result;
+    if ((cached = resultCache.get(key)))
+        result = *cached;
+    else if (auto algorithm = AlgorithmFactory::create(algoCode))
+    {
+        std::shared_ptr<Graph> g = cachedGraph({V, E, seed, maxWeight});
+        algorithm->deadline = Deadline::in(deadlineMs);
+        result = algorithm->execute(*g);
+        if (algorithm->complete)
+            resultCache.put(key, std::make_shared<const std::string>(result), result.size());
+    }
+    else
+        result = "Invalid algorithm code";
+    return frameReply(result, job);
+}
+
+// Single-threaded reactor: an edge-triggered epoll loop over non-blocking
+// sockets with a read and a write buffer per connection. Complete requests
+// go to a worker pool (light or heavy by estimated cost) one at a time per
+// connection, so replies keep the request order; the jobs of a batch go out
+// together and are answered as they finish. Finished replies come back
+// through `done` and an eventfd that wakes the loop.
+class EventLoop
+{
+    struct Connection
+    {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t sent = 0;
+        int pending = 0;         // jobs of this connection still in the pool
+        bool peerClosed = false; // the client sent EOF
+    };
+
+    struct Completion
+    {
+        uint64_t id;
+        std::string reply;
+        bool failed;
+    };
+
+    // epoll tags; connections are numbered from FIRST_CONNECTION and never
+    // reuse an id, so a reply for a closed connection is simply dropped
+    static const uint64_t LISTEN_TAG = 0;
+    static const uint64_t WAKE_TAG = 1;
+    static const uint64_t FIRST_CONNECTION = 2;
+
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    uint64_t nextId = FIRST_CONNECTION;
+    std::unordered_map<uint64_t, Connection> connections;
+    WorkerPool pool;
+    WorkerPool heavyPool;
+    std::mutex doneMtx;
+    std::vector<Completion> done;
+
+    static void setNonBlocking(int fd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void watch(int fd, uint64_t tag, uint32_t events)
+    {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = tag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void acceptAll()
+    {
+        while (true)
+        {
+            sockaddr_in addr{};
+            socklen_t len = sizeof(addr);
+            int fd = accept(listenFd, (sockaddr *)&addr, &len);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    perror("Accept failed");
+                return;
+            }
+            setNonBlocking(fd);
+
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+            std::cout << "Client connected from " << client_ip << ":" << ntohs(addr.sin_port) << std::endl;
+
+            uint64_t id = nextId++;
+            connections[id].fd = fd;
+            watch(fd, id, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+        }
+    }
+
+    void closeConnection(uint64_t id)
+    {
+        close(connections[id].fd);
+        connections.erase(id);
+        std::cout << "Client disconnected.\n";
+        printCacheStats();
+    }
+
+    // Reads until the socket would block; false on a socket error
+    bool readInput(Connection &c)
+    {
+        char buf[4096];
+        while (true)
+        {
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n > 0)
+                c.in.append(buf, n);
+            else if (n == 0)
+            {
+                c.peerClosed = true;
+                return true;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            else if (errno != EINTR)
+                return false;
+        }
+    }
+
+    // Writes until the buffer is empty or the socket would block (EPOLLOUT
+    // resumes it); false on a socket error
+    bool flushOutput(Connection &c)
+    {
+        while (c.sent < c.out.size())
+        {
+            ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0)
+                c.sent += n;
+            else if (n < 0 && errno == EINTR)
+                continue;
+            else
+                return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        c.out.clear();
+        c.sent = 0;
+        return true;
+    }
+
+    // Worker side: runs the request and queues the reply for the loop
+    void compute(uint64_t id, const std::vector<int> &request, int job)
+    {
+        Completion result{id, std::string(), false};
+        try
+        {
+            result.reply = handleRequest(request.data(), job);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << "\n";
+            result.failed = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(doneMtx);
+            done.push_back(std::move(result));
+        }
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0)
+            perror("eventfd write failed");
+    }
+
+    // Starts the next buffered request or batch, or closes a finished
+    // connection. Jobs over maxCost are answered here and never take a
+    // place in a pool queue; if that leaves nothing running, the next
+    // buffered request goes on at once.
+    void advance(uint64_t id)
+    {
+        Connection &c = connections[id];
+        while (c.pending == 0 && startNext(id, c))
+            if (!flushOutput(c))
+            {
+                closeConnection(id);
+                return;
+            }
+    }
+
+    // Dispatches the request or batch at the front of c.in; false if it is
+    // not complete yet (or the connection was closed)
+    bool startNext(uint64_t id, Connection &c)
+    {
+        int first = 0, jobs = 1;
+        size_t offset = 0;
+        if (c.in.size() >= sizeof(first))
+            memcpy(&first, c.in.data(), sizeof(first));
+        if (first == BATCH_MARKER && c.in.size() >= BATCH_HEADER_BYTES)
+        {
+            memcpy(&jobs, c.in.data() + sizeof(first), sizeof(jobs));
+            if (jobs <= 0 || jobs > MAX_BATCH_JOBS)
+            {
+                std::cerr << "Invalid batch size " << jobs << "\n";
+                closeConnection(id);
+                return false;
+            }
+            offset = BATCH_HEADER_BYTES;
+        }
+        bool complete = first == BATCH_MARKER ? offset > 0 && c.in.size() >= offset + jobs * REQUEST_BYTES
+                                              : c.in.size() >= REQUEST_BYTES;
+        if (complete)
+        {
+            for (int job = 0; job < jobs; ++job)
+            {
+                std::vector<int> request(REQUEST_INTS);
+                memcpy(request.data(), c.in.data() + offset + job * REQUEST_BYTES, REQUEST_BYTES);
+                int tag = offset > 0 ? job : -1;
+                double cost = AlgorithmFactory::estimateCost(request[4], request[0], request[1]);
+                if (cost > maxCost)
+                {
+                    c.out += frameReply(rejection(cost), tag);
+                    continue;
+                }
+                WorkerPool &target = cost > LIGHT_COST_LIMIT ? heavyPool : pool;
+                target.submit([this, id, request, tag]
+                              { compute(id, request, tag); });
+                ++c.pending;
+            }
+            c.in.erase(0, offset + jobs * REQUEST_BYTES);
+            return true;
+        }
+        if (c.peerClosed && c.out.empty())
+            closeConnection(id);
+        return false;
+    }
+
+    void collectReplies()
+    {
+        uint64_t count;
+        while (read(wakeFd, &count, sizeof(count)) > 0)
+            ;
+        std::vector<Completion> ready;
+        {
+            std::lock_guard<std::mutex> lock(doneMtx);
+            ready.swap(done);
+        }
+        for (auto &r : ready)
+        {
+            auto it = connections.find(r.id);
+            if (it == connections.end())
+                continue;
+            Connection &c = it->second;
+            --c.pending;
+            c.out += r.reply;
+            if (r.failed || !flushOutput(c))
+                closeConnection(r.id);
+            else
+                advance(r.id);
+        }
+    }
+
+    void service(uint64_t id, uint32_t events)
+    {
+        auto it = connections.find(id);
+        if (it == connections.end())
+            return;
+        Connection &c = it->second;
+        bool ok = !(events & EPOLLERR);
+        if (ok && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+            ok = readInput(c);
+        if (ok && (events & EPOLLOUT))
+            ok = flushOutput(c);
+        if (ok)
+            advance(id);
+        else
+            closeConnection(id);
+    }
+
+public:
+    EventLoop(int listenFd, int workers, int heavyWorkers)
+        : listenFd(listenFd), epollFd(epoll_create1(0)), wakeFd(eventfd(0, EFD_NONBLOCK)), pool(workers),
+          heavyPool(heavyWorkers)
+    {
+        setNonBlocking(listenFd);
+        watch(listenFd, LISTEN_TAG, EPOLLIN | EPOLLET);
+        watch(wakeFd, WAKE_TAG, EPOLLIN | EPOLLET);
+    }
+
+    void run()
+    {
+        epoll_event events[64];
+        while (true)
+        {
+            int n = epoll_wait(epollFd, events, 64, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                perror("epoll_wait failed");
+                return;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                uint64_t tag = events[i].data.u64;
+                if (tag == LISTEN_TAG)
+                    acceptAll();
+                else if (tag == WAKE_TAG)
+                    collectReplies();
+                else
+                    service(tag, events[i].events);
+            }
+        }
+    }
+};
+
+    int main(int argc, char *argv[]) {
+        int server_fd;
         struct sockaddr_in address;
-        int addrlen = sizeof(address);
+
+        int option;
+        while ((option = getopt(argc, argv, "d:l:")) != -1) {
+            if (option == 'd') {
+                deadlineMs = atoi(optarg);
+            } else if (option == 'l') {
+                maxCost = atof(optarg);
+            } else {
+                std::cerr << "Usage: " << argv[0] << " [-d deadline_ms] [-l max_cost]\n";
+                exit(EXIT_FAILURE);
+            }
+        }
 
         server_fd = socket(AF_INET, SOCK_STREAM, 0);
         if (server_fd == 0) {
@@ -356,61 +1699,18 @@ public:
             exit(EXIT_FAILURE);
         }
 
-        if (listen(server_fd, 3) < 0) {
+        if (listen(server_fd, SOMAXCONN) < 0) {
             perror("Listen failed");
             exit(EXIT_FAILURE);
         }
 
         std::cout << "Server listening on port " << PORT << "...\n";
 
-        while (true) {
-            new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen);
-            if (new_socket < 0) {
-                perror("Accept failed");
-                continue;
-            }
-
-            char client_ip[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &address.sin_addr, client_ip, INET_ADDRSTRLEN);
-            std::cout << "Client connected from " << client_ip << ":" << ntohs(address.sin_port) << std::endl;
-
-            while (true) {
-                int data[4]; // V, E, seed, algoCode
-                ssize_t bytesRead = read(new_socket, data, sizeof(data));
-                if (bytesRead != sizeof(data)) {
-                    std::cout << "Connection closed or invalid request.\n";
-                    break;
-                }
-
-                int V = data[0], E = data[1], seed = data[2], algoCode = data[3];
-
-                Graph g(V);
-                std::set<std::pair<int, int>> existing;
-                std::mt19937 rng(seed);
-                std::uniform_int_distribution<int> dist(0, V - 1);
-
-                while ((int)existing.size() < E) {
-                    int u = dist(rng);
-                    int v = dist(rng);
-                    if (u == v) continue;
-                    auto edge = std::minmax(u, v);
-                    if (!existing.count(edge)) {
-                        g.addEdge(edge.first, edge.second);
-                        existing.insert(edge);
-                    }
-                }
-
-                auto algorithm = AlgorithmFactory::create(algoCode);
-                std::string result = algorithm ? algorithm->execute(g) : "Invalid algorithm code";
-
-                int len = result.size();
-                write(new_socket, &len, sizeof(len));
-                write(new_socket, result.c_str(), len);
-            }
-
-            close(new_socket);
-            std::cout << "Client disconnected.\n";
-        }
+        // The heavy pool gets half as many threads, so expensive jobs can
+        // never occupy every core
+        int cores = std::max(1u, std::thread::hardware_concurrency());
+        EventLoop loop(server_fd, cores, std::max(1, cores / 2));
+        loop.run();
 
         close(server_fd);
         return 0;
@@ -0,0 +1,134 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// ================= LRU Cache =================
+// A size-bounded least-recently-used cache split into shards, each behind
+// its own lock, so threads looking up different keys rarely contend. Every
+// entry carries a cost in bytes; a shard evicts from its cold end until a
+// new entry fits its share of the budget. Values are handed out as shared
+// pointers, so an entry evicted while someone still uses it stays alive.
+
+// Hash for the fixed int arrays used as keys
+template <size_t N>
+struct IntsHash
+{
+    size_t operator()(const std::array<int, N> &key) const
+    {
+        uint64_t h = 0;
+        for (int v : key)
+        {
+            h = (h ^ (uint32_t)v) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<Value> value;
+        size_t cost;
+    };
+
+    struct Shard
+    {
+        std::mutex m;
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+        size_t used = 0;
+    };
+
+    // Bookkeeping charged to every entry on top of its own cost
+    static const size_t ENTRY_OVERHEAD = sizeof(Entry) + 64;
+
+    size_t shardCount;
+    size_t shardBudget;
+    std::unique_ptr<Shard[]> shards;
+    Hash hash;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+
+    Shard &shardFor(const Key &key)
+    {
+        return shards[(hash(key) >> 40) % shardCount];
+    }
+
+public:
+    explicit LruCache(size_t budgetBytes, size_t shardCount = 16)
+        : shardCount(shardCount), shardBudget(budgetBytes / shardCount), shards(new Shard[shardCount]) {}
+
+    // The cached value for key (now the most recently used), or null
+    std::shared_ptr<Value> get(const Key &key)
+    {
+        Shard &s = shardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(s.m);
+            auto it = s.index.find(key);
+            if (it != s.index.end())
+            {
+                s.entries.splice(s.entries.begin(), s.entries, it->second);
+                hitCount.fetch_add(1, std::memory_order_relaxed);
+                return it->second->value;
+            }
+        }
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // Whether put() would keep a value of this cost; lets a caller skip
+    // preparing a value that would be dropped
+    bool admits(size_t cost) const
+    {
+        return cost + ENTRY_OVERHEAD <= shardBudget;
+    }
+
+    // Caches value under key, replacing any older entry; a value that alone
+    // exceeds a shard's budget is not kept
+    void put(const Key &key, std::shared_ptr<Value> value, size_t cost)
+    {
+        if (!admits(cost))
+            return;
+        cost += ENTRY_OVERHEAD;
+        // Evicted values are released after the lock; a graph can be large
+        std::vector<std::shared_ptr<Value>> evicted;
+        Shard &s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.m);
+        auto it = s.index.find(key);
+        if (it != s.index.end())
+        {
+            s.used -= it->second->cost;
+            evicted.push_back(std::move(it->second->value));
+            s.entries.erase(it->second);
+            s.index.erase(it);
+        }
+        while (s.used + cost > shardBudget)
+        {
+            Entry &cold = s.entries.back();
+            s.used -= cold.cost;
+            evicted.push_back(std::move(cold.value));
+            s.index.erase(cold.key);
+            s.entries.pop_back();
+        }
+        s.entries.push_front(Entry{key, std::move(value), cost});
+        s.index.emplace(key, s.entries.begin());
+        s.used += cost;
+    }
+
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+};
+
+#endif
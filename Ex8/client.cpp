@@ -2,13 +2,38 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
+#include "framing.hpp"
 
 #define PORT 8080
 
-int main()
+int main(int argc, char *argv[])
 {
+    // -b asks for packed binary results and decodes them for display;
+    // -d sets a compute deadline in milliseconds (the server caps it);
+    // -s prints the server's metrics instead of running a request
+    bool binary = false;
+    bool stats = false;
+    int deadlineMs = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "bd:s")) != -1)
+    {
+        if (opt == 'b')
+            binary = true;
+        else if (opt == 'd')
+            deadlineMs = atoi(optarg);
+        else if (opt == 's')
+            stats = true;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-b] [-d deadline_ms] [-s]\n";
+            return 1;
+        }
+    }
+
     int sock = 0;
     struct sockaddr_in serv_addr;
 
@@ -29,39 +54,68 @@ int main()
         return 1;
     }
 
+    if (stats)
+    {
+        FrameQueue request;
+        request.push(1, OP_STATS, ResponseBuffer());
+        FrameReader reader;
+        FrameHeader header;
+        std::string response;
+        bool ok = request.flush(sock) && reader.next(sock, header, response) && header.code == STATUS_OK;
+        if (ok)
+            std::cout << response;
+        else
+            std::cerr << "Stats request failed.\n";
+        close(sock);
+        return ok ? 0 : 1;
+    }
+
     try
     {
-        int V, E, seed;
+        int V, E, seed, maxWeight;
         std::cout << "Enter number of vertices: ";
         std::cin >> V;
         std::cout << "Enter number of edges: ";
         std::cin >> E;
         std::cout << "Enter seed: ";
         std::cin >> seed;
+        std::cout << "Enter max edge weight (1 for unweighted): ";
+        std::cin >> maxWeight;
 
-        int data[3] = {V, E, seed};
-        send(sock, data, sizeof(data), 0);
-
-        int msgSize = 0;
-        if (read(sock, &msgSize, sizeof(msgSize)) != sizeof(msgSize))
+        int data[5] = {V, E, seed, maxWeight, deadlineMs};
+        const uint32_t requestId = 1;
+        FrameQueue request;
+        request.push(requestId, binary ? OP_ALGORITHMS_BINARY : OP_ALGORITHMS, std::string(reinterpret_cast<const char *>(data), sizeof(data)));
+        if (!request.flush(sock))
         {
-            std::cerr << "Failed to read response size.\n";
+            std::cerr << "Failed to send request.\n";
+            close(sock);
+            return 1;
         }
 
-        if (msgSize <= 0 || msgSize > 10000)
+        FrameReader reader;
+        FrameHeader header;
+        std::string response;
+        if (!reader.next(sock, header, response))
         {
-            std::cerr << "Invalid message size received.\n";
+            std::cerr << "Incomplete message received.\n";
+            close(sock);
+            return 1;
         }
 
-        std::vector<char> buffer(msgSize + 1, 0);
-        int received = read(sock, buffer.data(), msgSize);
-        if (received != msgSize)
+        bool answered = header.code == STATUS_OK || header.code == STATUS_PARTIAL;
+        if (header.requestId != requestId || !answered)
+            std::cerr << "Request " << header.requestId << " failed: ";
+        else if (binary && !decodeResults(response, response, V))
         {
-            std::cerr << "Incomplete message received.\n";
+            std::cerr << "Malformed binary response.\n";
+            close(sock);
+            return 1;
         }
-
+        if (header.code == STATUS_PARTIAL)
+            std::cerr << "Deadline reached; some results are partial.\n";
         std::cout << "Server Response: \n"
-                  << buffer.data();
+                  << response;
     }
     catch (const std::exception &e)
     {
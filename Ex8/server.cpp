@@ -1,40 +1,566 @@
 #include <iostream>
 #include <thread>
 #include <vector>
+#include <cstdint>
+#include <queue>
+#include <climits>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <set>
+#include <cmath>
 #include <random>
+#include <chrono>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <algorithm>
-#include <stack>
 #include <functional>
 #include <sstream>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include "framing.hpp"
+#include "cache.hpp"
+#include "metrics.hpp"
 
 
+// ======== Thread team ========
+// A fixed group of threads that run one job together. run() hands job(id)
+// to every member (the calling thread is member 0) and returns when all of
+// them have finished; between runs the other members sleep.
+class ThreadTeam
+{
+    std::vector<std::thread> members;
+    std::mutex m;
+    std::condition_variable wake, done;
+    std::function<void(int)> job;
+    unsigned long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void loop(int id)
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            job(id);
+            std::lock_guard<std::mutex> lock(m);
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+public:
+    explicit ThreadTeam(int size)
+    {
+        for (int id = 1; id < size; ++id)
+            members.emplace_back(&ThreadTeam::loop, this, id);
+    }
+
+    ~ThreadTeam()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : members)
+            t.join();
+    }
+
+    int size() const { return (int)members.size() + 1; }
+
+    void run(std::function<void(int)> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = std::move(task);
+            pending = (int)members.size();
+            ++generation;
+        }
+        wake.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [&] { return pending == 0; });
+    }
+};
+
+// ======== Deadlines ========
+// A request's compute budget: the point in time after which long searches
+// give up and report what they have. The default one never passes.
+struct Deadline
+{
+    std::chrono::steady_clock::time_point at = std::chrono::steady_clock::time_point::max();
+
+    // ms milliseconds from now; no limit if ms <= 0
+    static Deadline in(int ms)
+    {
+        Deadline d;
+        if (ms > 0)
+            d.at = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        return d;
+    }
+
+    bool passed() const { return std::chrono::steady_clock::now() >= at; }
+};
+
+// Polls a Deadline from one search's inner loop. The clock is read only
+// every POLL_INTERVAL calls, and once the deadline has passed poll() stays
+// true so the search unwinds quickly.
+class DeadlineCheck
+{
+    static const unsigned POLL_INTERVAL = 1024;
+    const Deadline &deadline;
+    unsigned polls = 0;
+    bool passed = false;
+
+public:
+    explicit DeadlineCheck(const Deadline &deadline) : deadline(deadline) {}
+
+    bool poll()
+    {
+        if (!passed && ++polls % POLL_INTERVAL == 0)
+            passed = deadline.passed();
+        return passed;
+    }
+
+    bool timedOut() const { return passed; }
+};
+
 class Graph
 {
     int V;
+    // Edges are collected here by addEdge() and packed into CSR form by freeze()
+    std::vector<std::pair<int, int>> edgeList;
+    // CSR adjacency: the neighbors of v are targets[offsets[v] .. offsets[v + 1])
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edgeIds; // edgeIds[i] is the index in edgeList of half-edge i
+    std::vector<int> weights; // weights[id] is the weight of edgeList[id]
+    bool unitWeights = true;
+    bool sorted = false;
+    // Edge membership index built by freeze(): a bit matrix (row v starts at
+    // adjBits[v * rowWords]) up to MATRIX_MAX_V vertices, a hash of packed
+    // (u, v) keys above that
+    static const int MATRIX_MAX_V = 4096;
+    // Largest V solved by the Held-Karp bitmask DP (2^(V-1) words of memory)
+    static const int HELD_KARP_MAX_V = 24;
+    // isConnected() switches to the parallel BFS at this many vertices, and
+    // a top-down level wakes the other threads only above this many edges
+    static const int PARALLEL_BFS_MIN_V = 1 << 16;
+    static const int PARALLEL_LEVEL_MIN_EDGES = 1 << 14;
+    // Direction switching thresholds of the parallel BFS
+    static const int BFS_ALPHA = 14;
+    static const int BFS_BETA = 24;
+    // findMSTWeight() runs parallel Borůvka from this many edges
+    static const int PARALLEL_MST_MIN_EDGES = 1 << 18;
+    std::vector<uint64_t> adjBits;
+    size_t rowWords = 0;
+    std::vector<uint64_t> edgeKeys;
+    size_t keyMask = 0;
+
+    static uint64_t edgeKey(int u, int v)
+    {
+        return ((uint64_t)(uint32_t)u << 32) | (uint32_t)v;
+    }
+
+    static size_t keySlot(uint64_t key)
+    {
+        return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 17);
+    }
+
+    void buildEdgeIndex()
+    {
+        adjBits.clear();
+        edgeKeys.clear();
+        if (V <= MATRIX_MAX_V)
+        {
+            rowWords = ((size_t)V + 63) / 64;
+            adjBits.assign((size_t)V * rowWords, 0);
+            for (int u = 0; u < V; ++u)
+                for (int v : neighbors(u))
+                    adjBits[u * rowWords + (v >> 6)] |= 1ULL << (v & 63);
+            return;
+        }
+        size_t cap = 16;
+        while (cap < targets.size() * 2)
+            cap <<= 1;
+        keyMask = cap - 1;
+        edgeKeys.assign(cap, 0);
+        for (int u = 0; u < V; ++u)
+        {
+            for (int v : neighbors(u))
+            {
+                // Keys are stored +1 so that 0 marks an empty slot
+                uint64_t key = edgeKey(u, v) + 1;
+                size_t i = keySlot(key) & keyMask;
+                while (edgeKeys[i] != 0 && edgeKeys[i] != key)
+                    i = (i + 1) & keyMask;
+                edgeKeys[i] = key;
+            }
+        }
+    }
 
 public:
-    std::vector<std::vector<int>> adj;
+    struct NeighborRange
+    {
+        const int *first;
+        const int *last;
+        const int *begin() const { return first; }
+        const int *end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+    Graph(int V) : V(V), offsets(V + 1, 0) {}
+
+    // Largest V whose Hamiltonian circuit is found by Held-Karp
+    static int heldKarpMaxV() { return HELD_KARP_MAX_V; }
 
-    Graph(int V) : V(V), adj(V) {}
+    void addEdge(int u, int v, int w = 1)
+    {
+        edgeList.emplace_back(u, v);
+        weights.push_back(w);
+        unitWeights &= w == 1;
+    }
 
-    void addEdge(int u, int v)
+    void reserveEdges(size_t count)
     {
-        adj[u].push_back(v);
-        adj[v].push_back(u);
+        edgeList.reserve(count);
+        weights.reserve(count);
+    }
+
+    // Builds the frozen CSR arrays from the edge list. Call once after the
+    // last addEdge(); every algorithm below reads only the CSR arrays.
+    void freeze(bool sortNeighbors = true)
+    {
+        offsets.assign(V + 1, 0);
+        for (const auto &e : edgeList)
+        {
+            ++offsets[e.first + 1];
+            ++offsets[e.second + 1];
+        }
+        for (int i = 0; i < V; ++i)
+            offsets[i + 1] += offsets[i];
+
+        // Half-edges are packed as (target << 32 | edge id) so that sorting a
+        // vertex's neighbors carries the edge ids along
+        std::vector<uint64_t> packed(offsets[V]);
+        std::vector<int> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t id = 0; id < edgeList.size(); ++id)
+        {
+            const auto &e = edgeList[id];
+            packed[pos[e.first]++] = (uint64_t)e.second << 32 | id;
+            packed[pos[e.second]++] = (uint64_t)e.first << 32 | id;
+        }
+
+        sorted = sortNeighbors;
+        if (sorted)
+            for (int v = 0; v < V; ++v)
+                std::sort(packed.begin() + offsets[v], packed.begin() + offsets[v + 1]);
+
+        targets.resize(packed.size());
+        edgeIds.resize(packed.size());
+        for (size_t i = 0; i < packed.size(); ++i)
+        {
+            targets[i] = (int)(packed[i] >> 32);
+            edgeIds[i] = (int)(uint32_t)packed[i];
+        }
+        buildEdgeIndex();
+    }
+
+    NeighborRange neighbors(int v) const
+    {
+        return {targets.data() + offsets[v], targets.data() + offsets[v + 1]};
+    }
+
+    int degree(int v) const
+    {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    // O(1) edge test against the index built by freeze()
+    bool hasEdge(int u, int v) const
+    {
+        if (V <= MATRIX_MAX_V)
+            return (adjBits[u * rowWords + (v >> 6)] >> (v & 63)) & 1;
+        uint64_t key = edgeKey(u, v) + 1;
+        for (size_t i = keySlot(key) & keyMask; edgeKeys[i] != 0; i = (i + 1) & keyMask)
+            if (edgeKeys[i] == key)
+                return true;
+        return false;
+    }
+
+    // Bit row of v's neighbors, or nullptr when V is above MATRIX_MAX_V
+    const uint64_t *adjacencyRow(int v) const
+    {
+        return V <= MATRIX_MAX_V ? adjBits.data() + v * rowWords : nullptr;
+    }
+
+    // Approximate heap footprint, used as the graph's cost in the cache
+    size_t memoryBytes() const
+    {
+        return sizeof(*this) + edgeList.capacity() * sizeof(edgeList[0]) +
+               (offsets.capacity() + targets.capacity() + edgeIds.capacity() + weights.capacity()) * sizeof(int) +
+               (adjBits.capacity() + edgeKeys.capacity()) * sizeof(uint64_t);
+    }
+
+    // Reusable traversal buffers, one set per thread. Visited marks are epoch
+    // stamps, so begin() starts a fresh traversal without clearing V flags.
+    struct Traversal
+    {
+        std::vector<unsigned> mark;
+        unsigned epoch = 0;
+        std::vector<int> stack;
+
+        void begin(int V)
+        {
+            if (mark.size() < (size_t)V)
+            {
+                mark.assign(V, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0)
+            {
+                std::fill(mark.begin(), mark.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool visited(int v) const { return mark[v] == epoch; }
+        void visit(int v) { mark[v] = epoch; }
+    };
+
+    static Traversal &traversal()
+    {
+        thread_local Traversal t;
+        return t;
+    }
+
+    // Iterative DFS from start over vertices not yet visited in the current
+    // epoch of t; calls visit(v) once for every vertex reached
+    template <typename Visit>
+    void dfs(int start, Traversal &t, Visit visit) const
+    {
+        t.stack.clear();
+        t.stack.push_back(start);
+        t.visit(start);
+        while (!t.stack.empty())
+        {
+            int v = t.stack.back();
+            t.stack.pop_back();
+            visit(v);
+            for (int u : neighbors(v))
+            {
+                if (!t.visited(u))
+                {
+                    t.visit(u);
+                    t.stack.push_back(u);
+                }
+            }
+        }
+    }
+
+    // Threads used by the parallel BFS and Borůvka passes on large graphs;
+    // 1 keeps every request on the serial code
+    static int &parallelThreads()
+    {
+        static int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+        return threads;
+    }
+
+    // The one team behind the parallel passes, built on first use with
+    // parallelThreads() members. Requests already run on a pool with a thread
+    // per core, so a pass only goes parallel if it can lease the team; one
+    // that finds it busy runs serially, and concurrent requests never start
+    // threads of their own.
+    struct SharedTeam
+    {
+        std::mutex lease;
+        ThreadTeam team{parallelThreads()};
+    };
+
+    static SharedTeam &sharedTeam()
+    {
+        static SharedTeam shared;
+        return shared;
+    }
+
+    // Direction-optimizing BFS (Beamer et al.) from start over atomic bitmaps;
+    // returns the number of vertices reached. Top-down levels expand a
+    // frontier list and claim neighbors with fetch_or. Once the frontier's
+    // edges exceed 1/BFS_ALPHA of the unexplored ones, levels run bottom-up:
+    // every unvisited vertex scans its neighbors for one in the frontier
+    // bitmap and stops at the first. It returns to top-down when the frontier
+    // shrinks below V/BFS_BETA vertices.
+    int parallelBfs(int start, ThreadTeam &team) const
+    {
+        size_t words = ((size_t)V + 63) / 64;
+        std::vector<std::atomic<uint64_t>> visited(words), frontier(words), next(words);
+        for (size_t w = 0; w < words; ++w)
+        {
+            visited[w].store(0, std::memory_order_relaxed);
+            frontier[w].store(0, std::memory_order_relaxed);
+            next[w].store(0, std::memory_order_relaxed);
+        }
+        auto bit = [](int v) { return 1ULL << (v & 63); };
+
+        // Per-member results of the current level
+        std::vector<std::vector<int>> found(team.size());
+        std::vector<int> foundCount(team.size());
+        std::vector<long long> foundEdges(team.size());
+        std::vector<int> queue{start};
+        visited[start >> 6].store(bit(start), std::memory_order_relaxed);
+
+        long long frontierEdges = degree(start);
+        long long unexploredEdges = (long long)targets.size() - frontierEdges;
+        int frontierSize = 1, reached = 1;
+        bool topDown = true;
+
+        // One top-down step over queue[first, last), newly claimed vertices
+        // go to found[id]
+        auto expandTopDown = [&](int id, size_t first, size_t last)
+        {
+            long long edges = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                for (int u : neighbors(queue[i]))
+                {
+                    std::atomic<uint64_t> &word = visited[u >> 6];
+                    if (word.load(std::memory_order_relaxed) & bit(u))
+                        continue;
+                    if (word.fetch_or(bit(u), std::memory_order_relaxed) & bit(u))
+                        continue;
+                    found[id].push_back(u);
+                    edges += degree(u);
+                }
+            }
+            foundCount[id] = (int)found[id].size();
+            foundEdges[id] = edges;
+        };
+
+        // One bottom-up step over bitmap words [first, last), which this
+        // member owns in visited and next
+        auto expandBottomUp = [&](int id, size_t first, size_t last)
+        {
+            int count = 0;
+            long long edges = 0;
+            for (size_t w = first; w < last; ++w)
+            {
+                size_t base = w * 64;
+                uint64_t unvisited = ~visited[w].load(std::memory_order_relaxed);
+                if (base + 64 > (size_t)V)
+                    unvisited &= (1ULL << (V - base)) - 1;
+                uint64_t claimed = 0;
+                for (uint64_t m = unvisited; m; m &= m - 1)
+                {
+                    int v = (int)(base + __builtin_ctzll(m));
+                    for (int u : neighbors(v))
+                    {
+                        if (frontier[u >> 6].load(std::memory_order_relaxed) & bit(u))
+                        {
+                            claimed |= bit(v);
+                            ++count;
+                            edges += degree(v);
+                            break;
+                        }
+                    }
+                }
+                if (claimed)
+                {
+                    visited[w].fetch_or(claimed, std::memory_order_relaxed);
+                    next[w].store(claimed, std::memory_order_relaxed);
+                }
+            }
+            foundCount[id] = count;
+            foundEdges[id] = edges;
+        };
+
+        auto level = [&](int id)
+        {
+            size_t total = topDown ? queue.size() : words;
+            size_t chunk = (total + team.size() - 1) / team.size();
+            size_t first = std::min(total, id * chunk), last = std::min(total, first + chunk);
+            if (topDown)
+                expandTopDown(id, first, last);
+            else
+                expandBottomUp(id, first, last);
+        };
+
+        while (frontierSize > 0)
+        {
+            bool wantTopDown = topDown ? frontierEdges * BFS_ALPHA <= unexploredEdges
+                                       : frontierSize * (long long)BFS_BETA < V;
+            if (wantTopDown != topDown)
+            {
+                // Hand the frontier over to the other representation
+                if (topDown)
+                {
+                    for (int v : queue)
+                        frontier[v >> 6].fetch_or(bit(v), std::memory_order_relaxed);
+                }
+                else
+                {
+                    queue.clear();
+                    for (size_t w = 0; w < words; ++w)
+                    {
+                        for (uint64_t m = frontier[w].exchange(0, std::memory_order_relaxed); m; m &= m - 1)
+                            queue.push_back((int)(w * 64 + __builtin_ctzll(m)));
+                    }
+                }
+                topDown = wantTopDown;
+            }
+
+            for (int id = 0; id < team.size(); ++id)
+            {
+                found[id].clear();
+                foundCount[id] = 0;
+                foundEdges[id] = 0;
+            }
+            // A small top-down level is not worth waking the team for
+            if (topDown && frontierEdges < PARALLEL_LEVEL_MIN_EDGES)
+                expandTopDown(0, 0, queue.size());
+            else
+                team.run(level);
+
+            frontierSize = 0;
+            frontierEdges = 0;
+            for (int id = 0; id < team.size(); ++id)
+            {
+                frontierSize += foundCount[id];
+                frontierEdges += foundEdges[id];
+            }
+            if (topDown)
+            {
+                queue.clear();
+                for (const auto &part : found)
+                    queue.insert(queue.end(), part.begin(), part.end());
+            }
+            else
+            {
+                frontier.swap(next);
+                for (auto &w : next)
+                    w.store(0, std::memory_order_relaxed);
+            }
+            reached += frontierSize;
+            unexploredEdges -= frontierEdges;
+        }
+        return reached;
     }
 
     bool isConnected()
     {
-        std::vector<bool> visited(V, false);
         int start = -1;
         for (int i = 0; i < V; ++i)
         {
-            if (!adj[i].empty())
+            if (degree(i) > 0)
             {
                 start = i;
                 break;
@@ -42,395 +568,1609 @@ public:
         }
         if (start == -1)
             return true;
-        dfs(start, visited);
+        if (V >= PARALLEL_BFS_MIN_V && parallelThreads() > 1)
+        {
+            SharedTeam &shared = sharedTeam();
+            std::unique_lock<std::mutex> lease(shared.lease, std::try_to_lock);
+            if (lease.owns_lock())
+            {
+                int withEdges = 0;
+                for (int i = 0; i < V; ++i)
+                    withEdges += degree(i) > 0;
+                return parallelBfs(start, shared.team) == withEdges;
+            }
+        }
+        Traversal &t = traversal();
+        t.begin(V);
+        dfs(start, t, [](int) {});
         for (int i = 0; i < V; ++i)
-            if (!visited[i] && !adj[i].empty())
+            if (!t.visited(i) && degree(i) > 0)
                 return false;
         return true;
     }
 
-    void dfs(int v, std::vector<bool> &visited)
+    bool isEulerianCircuitPossible()
+    {
+        for (int i = 0; i < V; ++i)
+            if (degree(i) % 2 != 0)
+                return false;
+        return isConnected();
+    }
+
+    std::vector<int> findEulerianCircuit()
+    {
+        std::vector<int> circuit;
+        if (V == 0 || !isEulerianCircuitPossible())
+            return circuit;
+        // Hierholzer over edge ids: each vertex keeps a cursor into its CSR
+        // range and skips edges already walked from the other endpoint, so the
+        // whole circuit is one O(V + E) pass without copying the graph
+        std::vector<bool> used(edgeList.size(), false);
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        std::vector<int> currPath;
+        std::vector<int> circuitResult;
+        circuitResult.reserve(edgeList.size() + 1);
+        int start = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            if (degree(v) > 0)
+            {
+                start = v;
+                break;
+            }
+        }
+        currPath.push_back(start);
+        while (!currPath.empty())
+        {
+            int v = currPath.back();
+            int &i = cursor[v];
+            while (i < offsets[v + 1] && used[edgeIds[i]])
+                ++i;
+            if (i < offsets[v + 1])
+            {
+                used[edgeIds[i]] = true;
+                currPath.push_back(targets[i++]);
+            }
+            else
+            {
+                circuitResult.push_back(v);
+                currPath.pop_back();
+            }
+        }
+        std::reverse(circuitResult.begin(), circuitResult.end());
+        return circuitResult;
+    }
+    // Formatters below write a result into out, as text or (binary) in the
+    // packed form described in framing.hpp
+    void eulerianCircuit(ResponseBuffer &out, bool binary = false)
+    {
+        auto circuit = findEulerianCircuit();
+        if (binary)
+        {
+            putSequence(out, circuit);
+            return;
+        }
+        if (circuit.empty())
+        {
+            out << "No Eulerian Circuit";
+            return;
+        }
+        out << "Eulerian Circuit: ";
+        for (int v : circuit)
+            out << v << ' ';
+    }
+
+    // Sort-based Kruskal: edges packed as (weight << 32 | edge id) so one
+    // integer sort orders them by weight
+    long long kruskalMST() const
+    {
+        std::vector<uint64_t> order(edgeList.size());
+        for (size_t id = 0; id < edgeList.size(); ++id)
+            order[id] = (uint64_t)weights[id] << 32 | id;
+        std::sort(order.begin(), order.end());
+
+        DisjointSets sets(V);
+        long long total = 0;
+        int joined = 0;
+        for (uint64_t key : order)
+        {
+            const auto &e = edgeList[(uint32_t)key];
+            if (sets.unite(e.first, e.second))
+            {
+                total += (long long)(key >> 32);
+                if (++joined == V - 1)
+                    break;
+            }
+        }
+        return total;
+    }
+
+    // Heap-based Prim, restarted from every vertex not yet in the forest.
+    // Stale heap entries are skipped instead of decreasing keys.
+    long long primMST() const
+    {
+        std::vector<char> inTree(V, 0);
+        std::vector<int> best(V, INT_MAX);
+        using Entry = std::pair<int, int>; // weight, vertex
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        long long total = 0;
+        for (int s = 0; s < V; ++s)
+        {
+            if (inTree[s])
+                continue;
+            best[s] = 0;
+            heap.push({0, s});
+            while (!heap.empty())
+            {
+                Entry top = heap.top();
+                heap.pop();
+                int v = top.second;
+                if (inTree[v] || top.first > best[v])
+                    continue;
+                inTree[v] = 1;
+                total += top.first;
+                for (int i = offsets[v]; i < offsets[v + 1]; ++i)
+                {
+                    int u = targets[i], w = weights[edgeIds[i]];
+                    if (!inTree[u] && w < best[u])
+                    {
+                        best[u] = w;
+                        heap.push({w, u});
+                    }
+                }
+            }
+        }
+        return total;
+    }
+
+    // Parallel Borůvka: each round the team scans the edges in chunks and
+    // keeps, per component, the cheapest leaving edge as an atomic minimum of
+    // (weight << 32 | edge id); the edge id breaks ties, so the chosen edges
+    // never form a cycle. The merges then run serially. Every round at least
+    // halves the number of components.
+    long long boruvkaMST(ThreadTeam &team) const
+    {
+        const uint64_t NONE = UINT64_MAX;
+        DisjointSets sets(V);
+        std::vector<int> comp(V);
+        std::vector<std::atomic<uint64_t>> cheapest(V);
+
+        auto scan = [&](int id)
+        {
+            size_t chunk = (edgeList.size() + team.size() - 1) / team.size();
+            size_t first = std::min(edgeList.size(), id * chunk);
+            size_t last = std::min(edgeList.size(), first + chunk);
+            for (size_t e = first; e < last; ++e)
+            {
+                int a = comp[edgeList[e].first], b = comp[edgeList[e].second];
+                if (a == b)
+                    continue;
+                uint64_t key = (uint64_t)weights[e] << 32 | e;
+                for (int c : {a, b})
+                {
+                    uint64_t cur = cheapest[c].load(std::memory_order_relaxed);
+                    while (key < cur && !cheapest[c].compare_exchange_weak(cur, key, std::memory_order_relaxed))
+                        ;
+                }
+            }
+        };
+
+        long long total = 0;
+        bool merged = true;
+        while (merged)
+        {
+            for (int v = 0; v < V; ++v)
+            {
+                comp[v] = sets.find(v);
+                cheapest[v].store(NONE, std::memory_order_relaxed);
+            }
+            team.run(scan);
+
+            merged = false;
+            for (int v = 0; v < V; ++v)
+            {
+                uint64_t key = cheapest[v].load(std::memory_order_relaxed);
+                if (key == NONE)
+                    continue;
+                const auto &e = edgeList[(uint32_t)key];
+                if (sets.unite(e.first, e.second))
+                {
+                    total += (long long)(key >> 32);
+                    merged = true;
+                }
+            }
+        }
+        return total;
+    }
+
+    // Minimum spanning forest weight. With unit weights every spanning forest
+    // is minimal, so the answer is V minus the number of components and no
+    // edge is sorted. Otherwise large graphs run parallel Borůvka, dense ones
+    // (a quarter or more of all vertex pairs) Prim and the rest Kruskal.
+    long long findMSTWeight()
+    {
+        if (unitWeights)
+        {
+            int count;
+            componentLabels(count);
+            return V - count;
+        }
+        if (edgeList.size() >= (size_t)PARALLEL_MST_MIN_EDGES && parallelThreads() > 1)
+        {
+            SharedTeam &shared = sharedTeam();
+            std::unique_lock<std::mutex> lease(shared.lease, std::try_to_lock);
+            if (lease.owns_lock())
+                return boruvkaMST(shared.team);
+        }
+        if (4 * (long long)edgeList.size() >= (long long)V * (V - 1) / 2)
+            return primMST();
+        return kruskalMST();
+    }
+    void MST(ResponseBuffer &out, bool binary = false)
+    {
+        if (binary)
+            putFixed64(out, findMSTWeight());
+        else
+            out << "MST weight: " << findMSTWeight();
+    }
+
+    // Vertices in degeneracy order (repeatedly remove a minimum-degree vertex),
+    // bucket-queue version of Batagelj-Zaversnik, O(V + E)
+    std::vector<int> degeneracyOrder() const
+    {
+        std::vector<int> deg(V), pos(V), vert(V);
+        int maxDeg = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            deg[v] = degree(v);
+            maxDeg = std::max(maxDeg, deg[v]);
+        }
+        std::vector<int> bin(maxDeg + 1, 0);
+        for (int v = 0; v < V; ++v)
+            ++bin[deg[v]];
+        for (int d = 0, start = 0; d <= maxDeg; ++d)
+        {
+            int num = bin[d];
+            bin[d] = start;
+            start += num;
+        }
+        for (int v = 0; v < V; ++v)
+        {
+            pos[v] = bin[deg[v]]++;
+            vert[pos[v]] = v;
+        }
+        for (int d = maxDeg; d > 0; --d)
+            bin[d] = bin[d - 1];
+        bin[0] = 0;
+
+        for (int i = 0; i < V; ++i)
+        {
+            int v = vert[i];
+            for (int u : neighbors(v))
+            {
+                if (deg[u] > deg[v])
+                {
+                    int du = deg[u], pu = pos[u], pw = bin[du], w = vert[pw];
+                    if (u != w)
+                    {
+                        pos[u] = pw;
+                        vert[pu] = w;
+                        pos[w] = pu;
+                        vert[pw] = u;
+                    }
+                    ++bin[du];
+                    --deg[u];
+                }
+            }
+        }
+        return vert;
+    }
+
+    // Bron-Kerbosch search inside one vertex's neighborhood. The k local
+    // vertices are renumbered 0..k-1 and every candidate set is a bitset of
+    // `words` words; each recursion level owns a slice of `sets`.
+    struct CliqueSearch
+    {
+        DeadlineCheck check;
+        size_t words = 0;
+        std::vector<uint64_t> rows; // local adjacency, row i at rows[i * words]
+        std::vector<uint64_t> sets;
+
+        explicit CliqueSearch(const Deadline &deadline) : check(deadline) {}
+
+        void reset(const Graph &g, const std::vector<int> &local, int setsPerLevel)
+        {
+            size_t k = local.size();
+            words = (k + 63) / 64;
+            rows.assign(k * words, 0);
+            for (size_t i = 0; i < k; ++i)
+                for (size_t j = i + 1; j < k; ++j)
+                    if (g.hasEdge(local[i], local[j]))
+                    {
+                        rows[i * words + (j >> 6)] |= 1ULL << (j & 63);
+                        rows[j * words + (i >> 6)] |= 1ULL << (i & 63);
+                    }
+            sets.assign((k + 2) * setsPerLevel * words, 0);
+        }
+
+        const uint64_t *row(size_t v) const { return rows.data() + v * words; }
+
+        // Every clique inside P (P is consumed; the child level follows it).
+        // Past the deadline it returns the cliques counted so far.
+        long long countAll(uint64_t *P)
+        {
+            long long total = 0;
+            uint64_t *child = P + words;
+            for (size_t w = 0; w < words; ++w)
+            {
+                while (P[w])
+                {
+                    if (check.poll())
+                        return total;
+                    size_t v = w * 64 + __builtin_ctzll(P[w]);
+                    P[w] &= P[w] - 1;
+                    ++total;
+                    const uint64_t *nv = row(v);
+                    bool any = false;
+                    for (size_t i = 0; i < words; ++i)
+                        any |= (child[i] = P[i] & nv[i]) != 0;
+                    if (any)
+                        total += countAll(child);
+                }
+            }
+            return total;
+        }
+
+        // Maximal cliques extending R with candidates P and excluded X, with
+        // Tomita pivoting. Level layout is P, X, then the branching set.
+        long long countMaximal(uint64_t *P)
+        {
+            if (check.poll())
+                return 0;
+            uint64_t *X = P + words, *branch = X + words, *child = branch + words;
+            bool pEmpty = true, xEmpty = true;
+            for (size_t i = 0; i < words; ++i)
+            {
+                pEmpty &= P[i] == 0;
+                xEmpty &= X[i] == 0;
+            }
+            if (pEmpty)
+                return xEmpty ? 1 : 0;
+
+            // Pivot: the vertex of P | X with the most neighbors in P
+            size_t pivot = 0;
+            int best = -1;
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t m = P[w] | X[w]; m; m &= m - 1)
+                {
+                    size_t u = w * 64 + __builtin_ctzll(m);
+                    const uint64_t *nu = row(u);
+                    int common = 0;
+                    for (size_t i = 0; i < words; ++i)
+                        common += __builtin_popcountll(P[i] & nu[i]);
+                    if (common > best)
+                    {
+                        best = common;
+                        pivot = u;
+                    }
+                }
+            }
+
+            const uint64_t *np = row(pivot);
+            for (size_t i = 0; i < words; ++i)
+                branch[i] = P[i] & ~np[i];
+
+            long long total = 0;
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t m = branch[w]; m; m &= m - 1)
+                {
+                    size_t v = w * 64 + __builtin_ctzll(m);
+                    const uint64_t *nv = row(v);
+                    for (size_t i = 0; i < words; ++i)
+                    {
+                        child[i] = P[i] & nv[i];
+                        child[words + i] = X[i] & nv[i];
+                    }
+                    total += countMaximal(child);
+                    P[w] &= ~(1ULL << (v & 63));
+                    X[w] |= 1ULL << (v & 63);
+                }
+            }
+            return total;
+        }
+    };
+
+    // Counts all non-empty cliques, or only the maximal ones. Each vertex v is
+    // the earliest member (in degeneracy order) of the cliques it roots, so
+    // the search only ever sees v's later neighbors as candidates and stays
+    // within the graph's degeneracy even when V is in the thousands.
+    // complete is false if the deadline cut the count short (a lower bound).
+    long long countCliques(const Deadline &deadline, bool &complete, bool maximalOnly = false)
+    {
+        std::vector<int> order = degeneracyOrder();
+        std::vector<int> rank(V);
+        for (int i = 0; i < V; ++i)
+            rank[order[i]] = i;
+
+        CliqueSearch search(deadline);
+        std::vector<int> local;
+        long long count = 0;
+        for (int v : order)
+        {
+            if (search.check.timedOut())
+                break;
+            local.clear();
+            for (int u : neighbors(v))
+                if (rank[u] > rank[v])
+                    local.push_back(u);
+            size_t later = local.size();
+
+            if (!maximalOnly)
+            {
+                search.reset(*this, local, 1);
+                for (size_t i = 0; i < later; ++i)
+                    search.sets[i >> 6] |= 1ULL << (i & 63);
+                count += 1 + search.countAll(search.sets.data());
+                continue;
+            }
+
+            for (int u : neighbors(v))
+                if (rank[u] < rank[v])
+                    local.push_back(u);
+            search.reset(*this, local, 3);
+            uint64_t *P = search.sets.data(), *X = P + search.words;
+            for (size_t i = 0; i < local.size(); ++i)
+                (i < later ? P : X)[i >> 6] |= 1ULL << (i & 63);
+            count += search.countMaximal(P);
+        }
+        complete = !search.check.timedOut();
+        return count;
+    }
+    void numCliques(ResponseBuffer &out, bool binary, const Deadline &deadline, bool &complete)
+    {
+        long long count = countCliques(deadline, complete);
+        if (binary)
+            putFixed64(out, count);
+        else if (complete)
+            out << "Number of Cliques: " << count;
+        else
+            out << "Number of Cliques: at least " << count << " (timed out)";
+    }
+    // Union-find with union by rank and path halving
+    struct DisjointSets
+    {
+        std::vector<int> parent;
+        std::vector<unsigned char> rank;
+
+        explicit DisjointSets(int n) : parent(n), rank(n, 0)
+        {
+            for (int i = 0; i < n; ++i)
+                parent[i] = i;
+        }
+
+        int find(int x)
+        {
+            while (parent[x] != x)
+                x = parent[x] = parent[parent[x]];
+            return x;
+        }
+
+        // Returns false if a and b were already in the same set
+        bool unite(int a, int b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return false;
+            if (rank[a] < rank[b])
+                std::swap(a, b);
+            parent[b] = a;
+            if (rank[a] == rank[b])
+                ++rank[a];
+            return true;
+        }
+    };
+
+    // addEdge() stores every edge in both directions, so the strongly
+    // connected components are the connected components: one union-find pass
+    // over the edge list, no transpose and no DFS. Returns each vertex's
+    // component, numbered in order of the component's smallest vertex; count
+    // receives the number of components.
+    std::vector<int> componentLabels(int &count) const
+    {
+        DisjointSets sets(V);
+        for (const auto &e : edgeList)
+            sets.unite(e.first, e.second);
+
+        std::vector<int> label(V), rootLabel(V, -1);
+        count = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            int root = sets.find(v);
+            if (rootLabel[root] < 0)
+                rootLabel[root] = count++;
+            label[v] = rootLabel[root];
+        }
+        return label;
+    }
+
+    std::vector<std::vector<int>> findSCCGroups()
+    {
+        int count;
+        std::vector<int> label = componentLabels(count);
+        std::vector<std::vector<int>> sccGroups(count);
+        for (int v = 0; v < V; ++v)
+            sccGroups[label[v]].push_back(v);
+        return sccGroups;
+    }
+
+    void SCC(ResponseBuffer &out, bool binary = false)
+    {
+        if (binary)
+        {
+            int count;
+            std::vector<int> label = componentLabels(count);
+            putLabels(out, label, count);
+            return;
+        }
+        auto groups = findSCCGroups();
+        if (groups.empty())
+        {
+            out << "No Strongly Connected Components found.";
+            return;
+        }
+
+        out << "Strongly Connected Components:";
+        for (size_t i = 0; i < groups.size(); ++i)
+        {
+            out << "\nComponent " << i + 1 << ": ";
+            for (int v : groups[i])
+            {
+                out << v << ' ';
+            }
+        }
+    }
+
+    // A Hamiltonian circuit needs a biconnected graph: one DFS from vertex 0
+    // (iterative, with low-links) rejects disconnected graphs and graphs with
+    // an articulation point (which also covers bridges when V >= 3)
+    bool isBiconnected()
+    {
+        std::vector<int> disc(V, -1), low(V), parent(V, -1), cursor(V, 0);
+        std::vector<int> stack;
+        int index = 0, rootChildren = 0;
+        disc[0] = low[0] = index++;
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            int v = stack.back();
+            if (cursor[v] < degree(v))
+            {
+                int u = neighbors(v).first[cursor[v]++];
+                if (disc[u] == -1)
+                {
+                    parent[u] = v;
+                    disc[u] = low[u] = index++;
+                    stack.push_back(u);
+                    if (v == 0)
+                        ++rootChildren;
+                }
+                else if (u != parent[v])
+                    low[v] = std::min(low[v], disc[u]);
+                continue;
+            }
+            stack.pop_back();
+            if (stack.empty())
+                break;
+            int p = stack.back();
+            low[p] = std::min(low[p], low[v]);
+            if (p != 0 && low[v] >= disc[p])
+                return false;
+        }
+        return index == V && rootChildren <= 1;
+    }
+
+    // Held-Karp over subsets of vertices 1..V-1 (bit i stands for vertex i + 1):
+    // reach[mask] holds every end vertex of a path that leaves 0 and visits
+    // exactly mask. O(2^V * V) time, 2^(V-1) words of memory.
+    std::vector<int> heldKarpCircuit(DeadlineCheck &check)
+    {
+        int n = V - 1;
+        uint32_t full = (1u << n) - 1;
+        std::vector<uint32_t> adjMask(V);
+        for (int v = 0; v < V; ++v)
+            adjMask[v] = (uint32_t)(adjacencyRow(v)[0] >> 1) & full;
+
+        std::vector<uint32_t> reach(full + 1, 0);
+        for (uint32_t mask = 1; mask <= full; ++mask)
+        {
+            if (check.poll())
+                return {};
+            if ((mask & (mask - 1)) == 0)
+            {
+                reach[mask] = mask & adjMask[0];
+                continue;
+            }
+            uint32_t ends = 0;
+            for (uint32_t m = mask; m; m &= m - 1)
+            {
+                int i = __builtin_ctz(m);
+                if (reach[mask ^ (1u << i)] & adjMask[i + 1])
+                    ends |= 1u << i;
+            }
+            reach[mask] = ends;
+        }
+
+        std::vector<int> path;
+        uint32_t ends = reach[full] & adjMask[0];
+        if (ends == 0)
+            return path;
+        // Walk back from an end adjacent to 0, peeling one vertex at a time
+        int cur = __builtin_ctz(ends);
+        for (uint32_t mask = full; mask; )
+        {
+            path.push_back(cur + 1);
+            mask ^= 1u << cur;
+            if (mask)
+                cur = __builtin_ctz(reach[mask] & adjMask[cur + 1]);
+        }
+        path.push_back(0);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Search state for the backtracking engine used above HELD_KARP_MAX_V
+    struct HamiltonSearch
+    {
+        DeadlineCheck check;
+        std::vector<int> path;
+        std::vector<char> visited;
+        std::vector<int> freeDeg; // unvisited neighbors of each vertex
+        std::vector<int> queue;
+        std::vector<int> seen;
+        int stamp = 0;
+
+        explicit HamiltonSearch(const Deadline &deadline) : check(deadline) {}
+    };
+
+    // Every unvisited vertex must stay reachable from the path's end through
+    // unvisited vertices, or the path can never be completed
+    bool remainderConnected(HamiltonSearch &s, int end, int remaining)
+    {
+        ++s.stamp;
+        s.queue.clear();
+        s.queue.push_back(end);
+        s.seen[end] = s.stamp;
+        int reached = 0;
+        for (size_t head = 0; head < s.queue.size(); ++head)
+        {
+            for (int u : neighbors(s.queue[head]))
+            {
+                if (!s.visited[u] && s.seen[u] != s.stamp)
+                {
+                    s.seen[u] = s.stamp;
+                    s.queue.push_back(u);
+                    ++reached;
+                }
+            }
+        }
+        return reached == remaining;
+    }
+
+    // Extends path[0..pos) one vertex at a time, trying the candidates with
+    // the fewest unvisited neighbors first (Warnsdorff's rule); gives up
+    // once the deadline passes
+    bool hamiltonUtil(int pos, HamiltonSearch &s)
+    {
+        if (s.check.poll())
+            return false;
+        int end = s.path[pos - 1];
+        if (pos == V)
+            return hasEdge(end, s.path[0]);
+
+        std::vector<int> candidates;
+        for (int v : neighbors(end))
+            if (!s.visited[v])
+                candidates.push_back(v);
+        std::sort(candidates.begin(), candidates.end(), [&](int a, int b)
+                  { return s.freeDeg[a] < s.freeDeg[b]; });
+
+        for (int v : candidates)
+        {
+            s.path[pos] = v;
+            s.visited[v] = true;
+            for (int u : neighbors(v))
+                --s.freeDeg[u];
+
+            // 0 must keep an unvisited neighbor to close the circuit through
+            bool feasible = pos + 1 == V || s.freeDeg[s.path[0]] > 0;
+            if (feasible && end != s.path[0])
+            {
+                // end becomes interior: its unvisited neighbors lose it, and each
+                // still needs two usable neighbors (unvisited, the new end v, or 0
+                // to close the circuit)
+                for (int w : neighbors(end))
+                {
+                    if (!s.visited[w] && s.freeDeg[w] + hasEdge(w, v) + hasEdge(w, s.path[0]) < 2)
+                    {
+                        feasible = false;
+                        break;
+                    }
+                }
+            }
+            if (feasible && pos + 1 < V)
+                feasible = remainderConnected(s, v, V - pos - 1);
+            if (feasible && hamiltonUtil(pos + 1, s))
+                return true;
+
+            for (int u : neighbors(v))
+                ++s.freeDeg[u];
+            s.visited[v] = false;
+        }
+        return false;
+    }
+
+    // Hamiltonian circuit as V vertices starting at 0 (the edge back to 0 is
+    // implied), or an empty vector when there is none. Cheap necessary
+    // conditions run first, then Held-Karp for small V, then backtracking.
+    // complete is false if the deadline ended the search without an answer.
+    std::vector<int> findHamiltonianCircuit(const Deadline &deadline, bool &complete)
     {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                dfs(u, visited);
+        std::vector<int> none;
+        complete = true;
+        if (V < 3)
+            return none;
+        for (int v = 0; v < V; ++v)
+            if (degree(v) < 2)
+                return none;
+        if (!isBiconnected())
+            return none;
+        if (V <= HELD_KARP_MAX_V)
+        {
+            DeadlineCheck check(deadline);
+            std::vector<int> path = heldKarpCircuit(check);
+            complete = !check.timedOut();
+            return path;
+        }
+
+        HamiltonSearch s(deadline);
+        s.path.assign(V, -1);
+        s.visited.assign(V, false);
+        s.freeDeg.resize(V);
+        s.seen.assign(V, 0);
+        for (int v = 0; v < V; ++v)
+            s.freeDeg[v] = degree(v);
+        s.path[0] = 0;
+        s.visited[0] = true;
+        for (int u : neighbors(0))
+            --s.freeDeg[u];
+        if (hamiltonUtil(1, s))
+            return s.path;
+        complete = !s.check.timedOut();
+        return none;
     }
 
-    bool isEulerianCircuitPossible()
+    void hamiltonianCircuit(ResponseBuffer &out, bool binary, const Deadline &deadline, bool &complete)
     {
-        for (int i = 0; i < V; ++i)
-            if (adj[i].size() % 2 != 0)
-                return false;
-        return isConnected();
+        std::vector<int> path = findHamiltonianCircuit(deadline, complete);
+        if (binary)
+            putSequence(out, path);
+        else if (!complete)
+            out << "Hamiltonian Circuit search timed out";
+        else if (!path.empty())
+        {
+            out << "Hamiltonian Circuit: ";
+            for (int v : path)
+                out << v << " -> ";
+            out << path[0];
+        }
+        else
+        {
+            out << "Graph does not have a Hamiltonian Circuit";
+        }
     }
+};
 
-    std::vector<int> findEulerianCircuit()
+// ======== Random graph generator ========
+// Builds a simple undirected graph with exactly E distinct edges, reproducible
+// for a given seed. Vertex pairs u < v are numbered k = v * (v - 1) / 2 + u and
+// E of those indices are drawn without replacement (Floyd's algorithm), so no
+// draw is ever rejected. Above 50% density the missing pairs are drawn instead
+// and every other pair is emitted in one sweep.
+class GraphGenerator
+{
+    // Open-addressing set of pair indices, sized once for the whole sample
+    class IndexSet
     {
-        std::vector<int> circuit;
-        if (!isEulerianCircuitPossible())
-            return circuit;
-        std::vector<std::vector<int>> tempAdj = adj;
-        std::stack<int> currPath;
-        std::vector<int> circuitResult;
-        currPath.push(0);
-        while (!currPath.empty())
+        std::vector<long long> slots;
+        size_t mask;
+
+    public:
+        explicit IndexSet(size_t expected)
+        {
+            size_t cap = 16;
+            while (cap < expected * 2)
+                cap <<= 1;
+            slots.assign(cap, -1);
+            mask = cap - 1;
+        }
+
+        // Returns false if k was already present
+        bool insert(long long k)
         {
-            int v = currPath.top();
-            if (!tempAdj[v].empty())
+            size_t i = (size_t)(k * 0x9E3779B97F4A7C15ULL) & mask;
+            while (slots[i] != -1)
             {
-                int u = tempAdj[v].back();
-                tempAdj[v].pop_back();
-                auto &revList = tempAdj[u];
-                revList.erase(std::find(revList.begin(), revList.end(), v));
-                currPath.push(u);
+                if (slots[i] == k)
+                    return false;
+                i = (i + 1) & mask;
             }
-            else
+            slots[i] = k;
+            return true;
+        }
+    };
+
+    static std::vector<long long> sampleIndices(long long total, long long count, std::mt19937 &rng)
+    {
+        std::vector<long long> picked;
+        picked.reserve(count);
+        IndexSet seen(count);
+        for (long long j = total - count; j < total; ++j)
+        {
+            long long t = std::uniform_int_distribution<long long>(0, j)(rng);
+            if (!seen.insert(t))
             {
-                circuitResult.push_back(v);
-                currPath.pop();
+                t = j;
+                seen.insert(t);
             }
+            picked.push_back(t);
         }
-        std::reverse(circuitResult.begin(), circuitResult.end());
-        return circuitResult;
+        return picked;
     }
-    std::string eulerianCircuit()
+
+    static std::pair<int, int> decodePair(long long k)
     {
-        auto circuit = findEulerianCircuit();
-        if (circuit.empty())
-            return "No Eulerian Circuit";
-        std::string result = "Eulerian Circuit: ";
-        for (int v : circuit)
-            result += std::to_string(v) + " ";
-        return result;
+        long long v = (long long)((1.0 + std::sqrt(1.0 + 8.0 * (double)k)) / 2.0);
+        while (v * (v - 1) / 2 > k)
+            --v;
+        while ((v + 1) * v / 2 <= k)
+            ++v;
+        return {(int)(k - v * (v - 1) / 2), (int)v};
     }
 
-    int findMSTWeight()
+public:
+    static long long maxEdges(int V)
     {
-        std::vector<std::tuple<int, int, int>> edges;
-        std::vector<int> parent(V);
-        for (int u = 0; u < V; ++u)
+        return V > 1 ? (long long)V * (V - 1) / 2 : 0;
+    }
+
+    // Weights are drawn uniformly from [1, maxWeight] after the edge set is
+    // sampled, so the same seed gives the same edges for any maxWeight
+    static Graph generate(int V, int E, int seed, int maxWeight = 1)
+    {
+        Graph g(std::max(V, 0));
+        long long total = maxEdges(V);
+        long long edges = std::min<long long>(std::max(E, 0), total);
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> weightDist(1, std::max(maxWeight, 1));
+        auto weight = [&]
+        { return maxWeight > 1 ? weightDist(rng) : 1; };
+
+        g.reserveEdges(edges);
+        if (edges <= total / 2)
         {
-            for (int v : adj[u])
+            for (long long k : sampleIndices(total, edges, rng))
             {
-                if (u < v)
-                    edges.emplace_back(1, u, v);
+                auto edge = decodePair(k);
+                g.addEdge(edge.first, edge.second, weight());
             }
         }
-        std::sort(edges.begin(), edges.end());
-        std::function<int(int)> find = [&](int x)
-        {
-            return parent[x] == x ? x : parent[x] = find(parent[x]);
-        };
-        for (int i = 0; i < V; ++i)
-            parent[i] = i;
-        int mstWeight = 0;
-        for (auto [w, u, v] : edges)
+        else
         {
-            int ru = find(u), rv = find(v);
-            if (ru != rv)
+            std::vector<long long> missing = sampleIndices(total, total - edges, rng);
+            std::sort(missing.begin(), missing.end());
+            size_t next = 0;
+            long long k = 0;
+            for (int v = 1; v < V; ++v)
             {
-                mstWeight += w;
-                parent[ru] = rv;
+                for (int u = 0; u < v; ++u, ++k)
+                {
+                    if (next < missing.size() && missing[next] == k)
+                        ++next;
+                    else
+                        g.addEdge(u, v, weight());
+                }
             }
         }
-        return mstWeight;
-    }
-    std::string MST()
-    {
-        int weight = findMSTWeight();
-        return "MST weight: " + std::to_string(weight);
+        g.freeze();
+        return g;
     }
+};
+
+// ======== Metrics ========
+// Stages timed for OP_STATS, per request unless noted: accepting a
+// connection, reading a readable socket, the leader handoff (from one
+// leader leaving epoll_wait to the next one entering it, while no thread
+// watches the sockets), generating a graph, each algorithm (in Algorithm
+// order; the formatters write straight into the response, so this includes
+// formatting and caching the result), joining the parts of a response, and
+// one flush of a socket's responses.
+enum Stage
+{
+    STAGE_ACCEPT,
+    STAGE_READ,
+    STAGE_HANDOFF,
+    STAGE_GENERATE,
+    STAGE_EULER,
+    STAGE_SERIALIZE = STAGE_EULER + 5,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+Metrics metrics({"accept", "read", "leader_handoff", "generate", "euler", "mst", "cliques", "scc", "hamilton",
+                 "serialize", "write"});
 
-    bool isClique(const std::vector<int> &nodes)
+// ======== Caches ========
+// Generation is deterministic in (V, E, seed, maxWeight), so repeated
+// requests share one generated graph and reuse each algorithm's formatted
+// result; text and binary results are cached apart.
+enum Algorithm { ALGO_EULER, ALGO_MST, ALGO_CLIQUES, ALGO_SCC, ALGO_HAMILTON, ALGO_COUNT };
+static_assert((int)ALGO_COUNT == RESULT_COUNT && (int)ALGO_HAMILTON == RESULT_HAMILTON, "binary results follow Algorithm order");
+using GraphKey = std::array<int, 4>;  // V, E, seed, maxWeight
+using ResultKey = std::array<int, 6>; // V, E, seed, maxWeight, algorithm, binary
+const size_t GRAPH_CACHE_BYTES = 256u << 20;
+const size_t RESULT_CACHE_BYTES = 64u << 20;
+LruCache<GraphKey, Graph, IntsHash<4>> graphCache(GRAPH_CACHE_BYTES);
+LruCache<ResultKey, const ResponseBuffer, IntsHash<6>> resultCache(RESULT_CACHE_BYTES);
+
+// The graph for key, generated on a cache miss
+std::shared_ptr<Graph> cachedGraph(const GraphKey &key)
+{
+    std::shared_ptr<Graph> g = graphCache.get(key);
+    if (!g)
     {
-        for (size_t i = 0; i < nodes.size(); ++i)
         {
-            for (size_t j = i + 1; j < nodes.size(); ++j)
-            {
-                int u = nodes[i], v = nodes[j];
-                if (std::find(adj[u].begin(), adj[u].end(), v) == adj[u].end())
-                    return false;
-            }
+            StageTimer timer(metrics, STAGE_GENERATE);
+            g = std::make_shared<Graph>(GraphGenerator::generate(key[0], key[1], key[2], key[3]));
         }
-        return true;
+        graphCache.put(key, g, g->memoryBytes());
     }
+    return g;
+}
 
-    int countCliques()
-    {
-        int count = 0;
-        int total = 1 << V; // All subsets
-
-        for (int mask = 1; mask < total; ++mask)
-        {
-            std::vector<int> subset;
-            for (int i = 0; i < V; ++i)
-            {
-                if (mask & (1 << i))
-                    subset.push_back(i);
-            }
-            if (isClique(subset))
-                count++;
-        }
+// Appends the cached result for key to out; false on a miss
+bool cachedResult(const ResultKey &key, ResponseBuffer &out)
+{
+    std::shared_ptr<const ResponseBuffer> hit = resultCache.get(key);
+    if (hit)
+        out.append(hit);
+    return hit != nullptr;
+}
 
-        return count;
-    }
-    std::string numCliques()
+// Formats the result for key from g into out and caches it, unless the
+// deadline cut it short; false in that case
+bool computeResult(Graph &g, const ResultKey &key, ResponseBuffer &out, const Deadline &deadline)
+{
+    bool binary = key[5];
+    bool complete = true;
+    StageTimer timer(metrics, STAGE_EULER + key[4]);
+    switch (key[4])
     {
-        int count = countCliques();
-        return "Number of Cliques: " + std::to_string(count);
+    case ALGO_EULER:
+        g.eulerianCircuit(out, binary);
+        break;
+    case ALGO_MST:
+        g.MST(out, binary);
+        break;
+    case ALGO_CLIQUES:
+        g.numCliques(out, binary, deadline, complete);
+        break;
+    case ALGO_SCC:
+        g.SCC(out, binary);
+        break;
+    case ALGO_HAMILTON:
+        g.hamiltonianCircuit(out, binary, deadline, complete);
+        break;
     }
-    void fillOrder(int v, std::vector<bool> &visited, std::stack<int> &Stack)
+    // The cache keeps the formatted chunks themselves and out goes on to
+    // reference them, so nothing is copied unless the result is short
+    if (complete && resultCache.admits(out.size()))
     {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                fillOrder(u, visited, Stack);
-        Stack.push(v);
+        std::shared_ptr<const ResponseBuffer> shared = ResponseBuffer::share(std::move(out));
+        resultCache.put(key, shared, shared->memoryBytes());
+        out.append(shared);
     }
+    return complete;
+}
+
+void printCacheStats()
+{
+    std::cout << "Cache hits/misses: graphs " << graphCache.hits() << "/" << graphCache.misses()
+              << ", results " << resultCache.hits() << "/" << resultCache.misses() << "\n";
+}
+
+// The OP_STATS answer: stage metrics, then cache state
+ResponseBuffer statsText()
+{
+    ResponseBuffer out;
+    metrics.write(out);
+    out << "# HELP graph_cache_hits_total Cache lookups that found an entry\n"
+        << "# TYPE graph_cache_hits_total counter\n"
+        << "graph_cache_hits_total{cache=\"graph\"} " << graphCache.hits() << '\n'
+        << "graph_cache_hits_total{cache=\"result\"} " << resultCache.hits() << '\n'
+        << "# HELP graph_cache_misses_total Cache lookups that found none\n"
+        << "# TYPE graph_cache_misses_total counter\n"
+        << "graph_cache_misses_total{cache=\"graph\"} " << graphCache.misses() << '\n'
+        << "graph_cache_misses_total{cache=\"result\"} " << resultCache.misses() << '\n';
+    return out;
+}
+
+// ======== Leader-Follower globals ========
+std::mutex mtx;
+std::condition_variable cv;
+bool hasLeader = false;
+Metrics::Clock::time_point leaderLeft; // when the last leader left epoll_wait
+bool stopServer = false;
+
+// ======== Requests ========
+const int REQUEST_INTS = 5; // V, E, seed, maxWeight, deadline ms
+const size_t REQUEST_BYTES = REQUEST_INTS * sizeof(int);
+const size_t SHORT_REQUEST_BYTES = REQUEST_BYTES - sizeof(int); // no deadline
 
-    Graph getTranspose()
+// Compute budget in milliseconds (0 for none). A request may ask for less
+// in its optional fifth int, never for more; past it the clique count and
+// the Hamiltonian search stop and the response is STATUS_PARTIAL.
+const int DEFAULT_DEADLINE_MS = 10000;
+int deadlineMs = DEFAULT_DEADLINE_MS;
+
+Deadline requestDeadline(int requestedMs)
+{
+    if (requestedMs > 0 && (deadlineMs <= 0 || requestedMs < deadlineMs))
+        return Deadline::in(requestedMs);
+    return Deadline::in(deadlineMs);
+}
+
+// Admission by estimated cost (roughly 1e8 steps a second, as in Ex7): a
+// request whose five results are estimated above maxCost is answered with
+// a rejection instead of being run
+const double DEFAULT_MAX_COST = 1e11;
+double maxCost = DEFAULT_MAX_COST;
+
+// Expected number of cliques in a uniform random graph with V vertices
+// and E edges: the sum over k of C(V, k) * p^(k(k-1)/2). The terms rise
+// then fall, so the sum stops at the first term below one past k = 2.
+double expectedCliques(int V, int E)
+{
+    double pairs = (double)V * (V - 1) / 2;
+    if (V <= 0 || E <= 0 || pairs <= 0)
+        return std::max(V, 0);
+    double logP = std::log(std::min(1.0, E / pairs));
+    // log C(V, k) is built up a factor at a time: std::lgamma writes the
+    // global signgam, and the estimate runs on several threads at once
+    double total = 0, logChoose = 0;
+    for (int k = 1; k <= V; ++k)
     {
-        Graph gT(V);
-        for (int u = 0; u < V; ++u)
-            for (int v : adj[u])
-                gT.addEdge(v, u);
-        return gT;
+        logChoose += std::log((double)(V - k + 1) / k);
+        double term = std::exp(logChoose + k * (k - 1) / 2.0 * logP);
+        total += term;
+        if (term < 1 && k > 2)
+            break;
     }
+    return total;
+}
 
-    void dfsSCCCollect(int v, std::vector<bool> &visited, std::vector<int> &component)
+// Rough step count for all five results on a generated graph with V
+// vertices and E edges. The clique count and the Hamiltonian search
+// dominate: every clique is visited once, Held-Karp costs V * 2^(V-2), and
+// the pruned backtracking above it is taken as V * E.
+double estimateCost(int V, int E)
+{
+    double n = std::max(V, 1), m = std::max(E, 1);
+    double hamilton = V <= Graph::heldKarpMaxV() ? std::ldexp(n, std::max(V - 2, 0)) : n * m;
+    return n + m + m * std::log2(m + 1) + expectedCliques(V, E) + hamilton;
+}
+
+// The answer to a request whose estimated cost is over maxCost
+std::string rejection(double cost)
+{
+    char text[96];
+    snprintf(text, sizeof(text), "Rejected: estimated cost %.3g exceeds the limit %.3g", cost, maxCost);
+    return text;
+}
+
+// ======== Connections ========
+// Several threads can be busy with one connection: one reads it while jobs
+// for its earlier frames finish elsewhere. Only the reader touches in;
+// another event that finds a reader sets again, and the reader goes round
+// once more before letting go, so no input is missed. Replies are pushed and
+// flushed under m by whichever thread has them, in the order they finish.
+// Jobs hold a reference, so the entry outlives its closing.
+struct Connection
+{
+    int fd;
+    std::mutex m; // guards everything below but in
+    std::string in;
+    FrameQueue out;
+    int pending = 0; // frames handed to jobs and not yet answered
+    bool reading = false;
+    bool again = false;
+    bool peerClosed = false;
+    bool failed = false;
+    bool closed = false;
+
+    explicit Connection(int fd) : fd(fd) {}
+};
+
+// One algorithm frame, run by whichever worker takes it
+struct Job
+{
+    std::shared_ptr<Connection> conn;
+    uint32_t requestId;
+    bool binary;
+    int data[REQUEST_INTS];
+};
+
+// ======== Reactors ========
+// An epoll instance with its listening socket, connection table and job
+// queue. In Leader-Follower mode every worker shares one reactor: the
+// listener is armed EPOLLONESHOT so one thread accepts at a time, and the
+// job queue is guarded by the Leader-Follower mutex, so a worker takes a job
+// instead of waiting to lead. In sharded mode (-s) each worker owns a
+// reactor whose listener is bound with SO_REUSEPORT; the kernel spreads new
+// connections over the listeners, the worker runs its own jobs between
+// epoll waits and no state is shared. connMtx only guards the table itself.
+struct Reactor
+{
+    int listenFd = -1;
+    int epollFd = -1;
+    bool shared = false;
+    std::mutex connMtx;
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    std::deque<Job> jobs;
+};
+
+void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+void watch(Reactor &r, int fd, uint32_t events, int op)
+{
+    epoll_event ev{};
+    bool oneShot = r.shared && fd == r.listenFd;
+    ev.events = events | EPOLLET | (oneShot ? (uint32_t)EPOLLONESHOT : 0u);
+    ev.data.fd = fd;
+    epoll_ctl(r.epollFd, op, fd, &ev);
+}
+
+// Non-blocking listener on port 8080; exits the process on failure
+int openListener(bool reusePort)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
     {
-        visited[v] = true;
-        component.push_back(v);
-        for (int u : adj[v])
-            if (!visited[u])
-                dfsSCCCollect(u, visited, component);
+        perror("Socket failed");
+        exit(EXIT_FAILURE);
     }
 
-    std::vector<std::vector<int>> findSCCGroups()
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
     {
-        std::stack<int> Stack;
-        std::vector<bool> visited(V, false);
+        perror("SO_REUSEPORT failed");
+        exit(EXIT_FAILURE);
+    }
 
-        //  1: DFS
-        for (int i = 0; i < V; ++i)
-            if (!visited[i])
-                fillOrder(i, visited, Stack);
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(8080);
 
-        //  2: Transpose
-        Graph gr = getTranspose();
-        visited.assign(V, false);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    {
+        perror("Bind failed");
+        exit(EXIT_FAILURE);
+    }
 
-        std::vector<std::vector<int>> sccGroups;
+    if (listen(fd, SOMAXCONN) < 0)
+    {
+        perror("Listen failed");
+        exit(EXIT_FAILURE);
+    }
 
-        //  3: DFS on Transpose
-        while (!Stack.empty())
-        {
-            int v = Stack.top();
-            Stack.pop();
-            if (!visited[v])
-            {
-                std::vector<int> component;
-                gr.dfsSCCCollect(v, visited, component);
-                sccGroups.push_back(component);
-            }
-        }
+    setNonBlocking(fd);
+    return fd;
+}
 
-        return sccGroups;
+void openReactor(Reactor &r, int listenFd, bool shared)
+{
+    r.listenFd = listenFd;
+    r.shared = shared;
+    r.epollFd = epoll_create1(0);
+    if (r.epollFd < 0)
+    {
+        perror("epoll_create1 failed");
+        exit(EXIT_FAILURE);
     }
+    watch(r, listenFd, EPOLLIN, EPOLL_CTL_ADD);
+}
 
-    std::string SCC()
+void closeClient(Reactor &r, int fd)
+{
     {
-        auto groups = findSCCGroups();
-        if (groups.empty())
-        {
-            return "No Strongly Connected Components found.";
-        }
+        std::lock_guard<std::mutex> lock(r.connMtx);
+        r.connections.erase(fd);
+    }
+    close(fd);
+    std::cout << "Client disconnected.\n";
+    printCacheStats();
+}
 
-        std::ostringstream oss;
-        oss << "Strongly Connected Components:\n";
-        for (size_t i = 0; i < groups.size(); ++i)
-        {
-            oss << "Component " << i + 1 << ": ";
-            for (int v : groups[i])
-            {
-                oss << v << " ";
-            }
-            oss << "\n";
-        }
-        return oss.str();
+// Closes c once nothing more can come of it: the socket failed, or the
+// client has finished sending, no job is out and every reply is written.
+// Called with c.m held by each thread that may have made that true; a
+// reader closes it when it lets go, so the socket never closes under it.
+void closeIfDone(Reactor &r, Connection &c)
+{
+    if (c.closed || c.reading)
+        return;
+    if (c.failed || (c.peerClosed && c.pending == 0 && c.out.empty()))
+    {
+        c.closed = true;
+        closeClient(r, c.fd);
     }
+}
+
+// Writes what the socket accepts; the rest waits for EPOLLOUT. Called with
+// c.m held
+void flushReplies(Connection &c)
+{
+    StageTimer timer(metrics, STAGE_WRITE);
+    if (!c.closed && !c.out.flush(c.fd))
+        c.failed = true;
+}
 
-    bool hamiltonUtil(int pos, std::vector<int> &path, std::vector<bool> &visited)
+// Hands a job to the workers: a Leader-Follower worker takes it instead of
+// waiting to lead, a shard worker runs it between epoll waits
+void queueJob(Reactor &r, Job job)
+{
+    if (!r.shared)
     {
-        if (pos == V)
-        {
-            return std::find(adj[path[pos - 1]].begin(), adj[path[pos - 1]].end(), path[0]) != adj[path[pos - 1]].end();
+        r.jobs.push_back(std::move(job));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        r.jobs.push_back(std::move(job));
+    }
+    cv.notify_one();
+}
+
+// ======== Accept new clients ========
+void acceptClients(Reactor &r)
+{
+    while (true) {
+        auto start = Metrics::Clock::now();
+        sockaddr_in client_addr{};
+        socklen_t client_len = sizeof(client_addr);
+        int client_socket = accept(r.listenFd, (sockaddr *)&client_addr, &client_len);
+        if (client_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
         }
+        setNonBlocking(client_socket);
+
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+        std::cout << "Client connected from " << client_ip << ":" << ntohs(client_addr.sin_port) << "\n";
 
-        for (int v = 1; v < V; ++v)
         {
-            if (!visited[v] && std::find(adj[path[pos - 1]].begin(), adj[path[pos - 1]].end(), v) != adj[path[pos - 1]].end())
-            {
-                path[pos] = v;
-                visited[v] = true;
-                if (hamiltonUtil(pos + 1, path, visited))
-                    return true;
-                visited[v] = false;
-            }
+            std::lock_guard<std::mutex> lock(r.connMtx);
+            r.connections[client_socket] = std::make_shared<Connection>(client_socket);
         }
-        return false;
+        watch(r, client_socket, EPOLLIN | EPOLLOUT | EPOLLRDHUP, EPOLL_CTL_ADD);
+        metrics.record(STAGE_ACCEPT, Metrics::Clock::now() - start);
     }
+    if (r.shared)
+        watch(r, r.listenFd, EPOLLIN, EPOLL_CTL_MOD);
+}
 
-    std::string hamiltonianCircuit()
+// ======== Run one request ========
+// complete is false if the deadline cut a result short
+ResponseBuffer handleRequest(const int *data, bool binary, bool &complete)
+{
+    Deadline deadline = requestDeadline(data[4]);
+    std::shared_ptr<Graph> g; // fetched on the first result that misses
+    ResponseBuffer parts[ALGO_COUNT];
+    bool done[ALGO_COUNT] = {true, true, true, true, true};
+    for (int algorithm = 0; algorithm < ALGO_COUNT; ++algorithm)
     {
-        std::vector<int> path(V, -1);
-        std::vector<bool> visited(V, false);
-        path[0] = 0;
-        visited[0] = true;
-
-        if (hamiltonUtil(1, path, visited))
-        {
-            std::string result = "Hamiltonian Circuit: ";
-            for (int v : path)
-                result += std::to_string(v) + " -> ";
-            result += std::to_string(path[0]); 
-            return result;
-        }
-        else
+        ResultKey key{data[0], data[1], data[2], data[3], algorithm, binary};
+        if (!cachedResult(key, parts[algorithm]))
         {
-            return "Graph does not have a Hamiltonian Circuit";
+            if (!g)
+                g = cachedGraph({data[0], data[1], data[2], data[3]});
+            done[algorithm] = computeResult(*g, key, parts[algorithm], deadline);
         }
     }
-};
 
-// ======== Leader-Follower globals ========
-int server_fd;
-std::mutex mtx;
-std::condition_variable cv;
-bool hasLeader = false;
-bool stopServer = false;
+    complete = std::all_of(done, done + ALGO_COUNT, [](bool c) { return c; });
+
+    StageTimer timer(metrics, STAGE_SERIALIZE);
+    ResponseBuffer out;
+    joinResults(out, parts, done, binary);
+    return out;
+}
 
-// ======== Handle one client ========
-void handleClient(int client_socket, sockaddr_in client_addr)
+// ======== Run one job ========
+// Computes the request and sends its reply as soon as it is ready, ahead of
+// any earlier frame of the connection still running
+void runJob(Reactor &r, Job &job)
 {
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-    std::cout << "Client connected from " << client_ip << ":" << ntohs(client_addr.sin_port) << "\n";
+    uint32_t status;
+    ResponseBuffer response;
+    try {
+        bool complete;
+        response = handleRequest(job.data, job.binary, complete);
+        status = complete ? STATUS_OK : STATUS_PARTIAL;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        status = STATUS_ERROR;
+        response = ResponseBuffer(e.what());
+    }
+    metrics.requestDone(status);
 
-    int data[3]; 
-    ssize_t bytesRead = read(client_socket, data, sizeof(data));
-    if (bytesRead != sizeof(data)) {
-        std::cout << "Connection closed or invalid request.\n";
-        close(client_socket);
-        return;
+    Connection &c = *job.conn;
+    std::lock_guard<std::mutex> lock(c.m);
+    --c.pending;
+    if (!c.closed) {
+        c.out.push(job.requestId, status, std::move(response));
+        flushReplies(c);
     }
+    closeIfDone(r, c);
+}
 
-    int V = data[0], E = data[1], seed = data[2];
-    Graph g(V);
-    std::set<std::pair<int,int>> existing;
-    std::mt19937 rng(seed);
-    std::uniform_int_distribution<int> dist(0, V - 1);
+// Parses every complete frame at the front of conn->in: algorithm frames
+// become jobs and the rest are answered at once. Called by the reader;
+// false on a malformed frame
+bool answerFrames(Reactor &r, const std::shared_ptr<Connection> &conn)
+{
+    Connection &c = *conn;
+    size_t used = 0;
+    FrameHeader header;
+    const char *payload;
+    size_t payloadBytes;
+    int parsed;
+    while ((parsed = parseFrame(c.in, used, header, payload, payloadBytes, MAX_REQUEST_FRAME)) > 0) {
+        bool known = header.code == OP_ALGORITHMS || header.code == OP_ALGORITHMS_BINARY;
+        if (known && (payloadBytes == REQUEST_BYTES || payloadBytes == SHORT_REQUEST_BYTES)) {
+            Job job{conn, header.requestId, header.code == OP_ALGORITHMS_BINARY, {}};
+            memcpy(job.data, payload, payloadBytes);
+            double cost = estimateCost(job.data[0], job.data[1]);
+            if (cost > maxCost) {
+                std::lock_guard<std::mutex> lock(c.m);
+                c.out.push(header.requestId, STATUS_ERROR, rejection(cost));
+                metrics.requestDone(STATUS_ERROR);
+            } else {
+                {
+                    std::lock_guard<std::mutex> lock(c.m);
+                    ++c.pending;
+                }
+                queueJob(r, std::move(job));
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(c.m);
+            if (header.code == OP_STATS && payloadBytes == 0) {
+                c.out.push(header.requestId, STATUS_OK, statsText());
+            } else {
+                c.out.push(header.requestId, STATUS_ERROR, "Unknown opcode or malformed request");
+                metrics.requestDone(STATUS_ERROR);
+            }
+        }
+    }
+    c.in.erase(0, used);
+    return parsed == 0;
+}
 
-    while ((int)existing.size() < E) {
-        int u = dist(rng);
-        int v = dist(rng);
-        if (u == v) continue;
-        auto edge = std::minmax(u, v);
-        if (!existing.count(edge)) {
-            g.addEdge(edge.first, edge.second);
-            existing.insert(edge);
+// ======== Handle one client event ========
+// EPOLLOUT writes the replies that did not fit before. Input is read until
+// the socket would block and every complete frame is parsed, by one thread
+// at a time (see Connection); the jobs it queues answer in any order. The
+// connection stays open for more requests and closes once the client has
+// finished sending and every reply is out.
+void handleClient(Reactor &r, int client_socket, uint32_t events)
+{
+    std::shared_ptr<Connection> conn;
+    {
+        std::lock_guard<std::mutex> lock(r.connMtx);
+        auto it = r.connections.find(client_socket);
+        if (it == r.connections.end())
+            return;
+        conn = it->second;
+    }
+    Connection &c = *conn;
+    {
+        std::lock_guard<std::mutex> lock(c.m);
+        if (events & EPOLLERR)
+            c.failed = true;
+        else if (events & EPOLLOUT)
+            flushReplies(c);
+        bool input = (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !c.failed && !c.closed;
+        if (!input || c.reading) {
+            c.again |= input;
+            closeIfDone(r, c);
+            return;
         }
+        c.reading = true;
     }
 
-    std::ostringstream oss;
-    oss << g.eulerianCircuit() << "\n";
-    oss << g.MST() << "\n";
-    oss << g.numCliques() << "\n";
-    oss << g.SCC() << "\n";
-    oss << g.hamiltonianCircuit() << "\n";
+    while (true) {
+        // Only the reader sets peerClosed, so it reads it without the lock
+        bool eof = false, readFailed = false;
+        char buf[4096];
+        auto readStart = Metrics::Clock::now();
+        while (!c.peerClosed && !eof) {
+            ssize_t n = read(client_socket, buf, sizeof(buf));
+            if (n > 0) {
+                c.in.append(buf, n);
+            } else if (n == 0) {
+                eof = true;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                readFailed = true;
+                break;
+            }
+        }
+        metrics.record(STAGE_READ, Metrics::Clock::now() - readStart);
 
-    std::string result = oss.str();
-    int len = result.size();
-    write(client_socket, &len, sizeof(len));
-    write(client_socket, result.c_str(), len);
+        bool valid = readFailed || answerFrames(r, conn);
+        if (!valid)
+            std::cout << "Invalid request frame.\n";
 
-    close(client_socket);
-    std::cout << "Client disconnected.\n";
+        std::lock_guard<std::mutex> lock(c.m);
+        c.peerClosed |= eof || !valid;
+        c.failed |= readFailed;
+        flushReplies(c);
+        if (c.again && !c.failed && !c.peerClosed) {
+            c.again = false;
+            continue;
+        }
+        c.reading = false;
+        c.again = false;
+        closeIfDone(r, c);
+        return;
+    }
 }
 
 // ======== Worker thread function (Leader-Follower) ========
-void workerThread()
+// A worker runs a queued job if there is one and otherwise waits to lead.
+// The leader blocks in epoll_wait for a single event, then promotes a
+// follower and processes the event itself
+void workerThread(Reactor &r)
 {
     while (!stopServer) {
-        sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
-        int client_socket = -1;
+        epoll_event event{};
+        int ready = 0;
 
         {
             std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [] { return !hasLeader || stopServer; });
+            cv.wait(lock, [&] { return !hasLeader || !r.jobs.empty() || stopServer; });
             if (stopServer) return;
 
-            hasLeader = true; 
+            if (!r.jobs.empty()) {
+                Job job = std::move(r.jobs.front());
+                r.jobs.pop_front();
+                // The wakeup may have been meant for a new leader
+                if (!hasLeader)
+                    cv.notify_one();
+                lock.unlock();
+                runJob(r, job);
+                continue;
+            }
+
+            if (leaderLeft != Metrics::Clock::time_point())
+                metrics.record(STAGE_HANDOFF, Metrics::Clock::now() - leaderLeft);
+            hasLeader = true;
             lock.unlock();
 
-            client_socket = accept(server_fd, (sockaddr *)&client_addr, &client_len);
+            ready = epoll_wait(r.epollFd, &event, 1, -1);
 
             lock.lock();
             hasLeader = false;
+            leaderLeft = Metrics::Clock::now();
             cv.notify_one();
             lock.unlock();
         }
 
-        if (client_socket >= 0)
-            handleClient(client_socket, client_addr);
+        if (ready <= 0)
+            continue;
+        if (event.data.fd == r.listenFd)
+            acceptClients(r);
+        else
+            handleClient(r, event.data.fd, event.events);
     }
 }
 
-// ======== Main ========
-int main()
+// ======== Worker thread function (sharded) ========
+// Runs its own reactor: no leader handoff, every event is handled in place
+// and one queued job runs after each round of events
+void shardThread(Reactor &r)
 {
-    struct sockaddr_in address{};
-
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == 0)
-    {
-        perror("Socket failed");
-        exit(EXIT_FAILURE);
+    epoll_event events[64];
+    while (!stopServer) {
+        int ready = epoll_wait(r.epollFd, events, 64, r.jobs.empty() ? -1 : 0);
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd == r.listenFd)
+                acceptClients(r);
+            else
+                handleClient(r, events[i].data.fd, events[i].events);
+        }
+        if (!r.jobs.empty()) {
+            Job job = std::move(r.jobs.front());
+            r.jobs.pop_front();
+            runJob(r, job);
+        }
     }
+}
 
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(8080);
-
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+// ======== Main ========
+int main(int argc, char *argv[])
+{
+    int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    bool sharded = false;
+    int option;
+    while ((option = getopt(argc, argv, "p:t:sd:l:")) != -1)
     {
-        perror("Bind failed");
-        exit(EXIT_FAILURE);
+        switch (option)
+        {
+        case 'p':
+            Graph::parallelThreads() = std::max(1, std::stoi(optarg));
+            break;
+        case 't':
+            threadCount = std::max(1, std::stoi(optarg));
+            break;
+        case 's':
+            sharded = true;
+            break;
+        case 'd':
+            deadlineMs = std::max(0, std::stoi(optarg));
+            break;
+        case 'l':
+            maxCost = atof(optarg);
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0]
+                      << " [-p <threads>] [-t <workers>] [-s] [-d <deadline ms>] [-l <max cost>]\n";
+            return 1;
+        }
     }
 
-    if (listen(server_fd, 10) < 0)
-    {
-        perror("Listen failed");
-        exit(EXIT_FAILURE);
-    }
+    // One shared reactor, or one per worker each with its own listener
+    std::vector<Reactor> reactors(sharded ? threadCount : 1);
+    for (auto &r : reactors)
+        openReactor(r, openListener(sharded), !sharded);
 
     std::cout << "Server listening on port 8080...\n";
 
-    const int THREAD_COUNT = 4;
     std::vector<std::thread> threads;
-    for (int i = 0; i < THREAD_COUNT; i++)
+    for (int i = 0; i < threadCount; i++)
     {
-        threads.emplace_back(workerThread);
+        if (sharded)
+            threads.emplace_back(shardThread, std::ref(reactors[i]));
+        else
+            threads.emplace_back(workerThread, std::ref(reactors[0]));
     }
 
     for (auto &t : threads)
         t.join();
 
-    close(server_fd);
+    for (auto &r : reactors)
+    {
+        close(r.epollFd);
+        close(r.listenFd);
+    }
     return 0;
 }
@@ -0,0 +1,239 @@
+// Microbenchmarks for the Graph algorithms and the generator, in the style of
+// Google Benchmark: every case runs with doubling iteration counts until one
+// batch takes at least the minimum time, then reports time per operation,
+// edges per second and heap allocations per operation. Graphs come from
+// fixed seeds, so two builds can be compared case by case from the JSON.
+#define GRAPH_BENCH
+#include "server.cpp"
+
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+// ================= Allocation Counting =================
+// Every operator new in the process lands here (array and nothrow forms
+// forward to it by default). The deletes stay out of line so GCC does not
+// pair the inlined free() with a new-expression and warn.
+std::atomic<uint64_t> allocCount{0};
+std::atomic<uint64_t> allocBytes{0};
+
+void *operator new(size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// ================= Measurement =================
+// Keeps the compiler from discarding a result it can see is unused
+template <typename T>
+void keep(const T &value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+double cpuSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Result
+{
+    std::string name;
+    int V;
+    long long E;
+    int seed;
+    long long iterations;
+    double realNs; // per iteration
+    double cpuNs;
+    double allocs;
+    double bytes;
+};
+
+struct Options
+{
+    double minTime = 0.5;  // seconds one batch must reach
+    const char *filter = ""; // run only names containing this
+    const char *jsonPath = nullptr;
+};
+
+Options options;
+std::vector<Result> results;
+
+// Times op(), which works on a graph with V vertices and E edges
+template <typename Op>
+void measure(const std::string &family, int V, long long E, int seed, Op op)
+{
+    std::string name = family + "/V:" + std::to_string(V) + "/E:" + std::to_string(E);
+    if (name.find(options.filter) == std::string::npos)
+        return;
+
+    op(); // warm-up: first-touch faults, thread-local scratch, caches
+    long long iterations = 1;
+    while (true)
+    {
+        uint64_t allocs = allocCount.load(), bytes = allocBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        double cpuStart = cpuSeconds();
+        for (long long i = 0; i < iterations; ++i)
+            op();
+        double cpu = cpuSeconds() - cpuStart;
+        double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (real >= options.minTime || iterations >= (1LL << 30))
+        {
+            Result r{name, V, E, seed, iterations, real * 1e9 / iterations, cpu * 1e9 / iterations,
+                     (double)(allocCount.load() - allocs) / iterations,
+                     (double)(allocBytes.load() - bytes) / iterations};
+            printf("%-44s %14.0f %14.0f %10lld %12.4g %10.1f\n", r.name.c_str(), r.realNs, r.cpuNs,
+                   r.iterations, E * 1e9 / r.realNs, r.allocs);
+            fflush(stdout);
+            results.push_back(r);
+            return;
+        }
+        // Aim past minTime in one step, as Google Benchmark does
+        double scale = real > 0 ? options.minTime * 1.4 / real : 10;
+        iterations = (long long)(iterations * std::min(10.0, std::max(2.0, scale)));
+    }
+}
+
+void writeJson(const char *path)
+{
+    std::ofstream out(path);
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"parallel_threads\": " << Graph::parallelThreads() << ",\n"
+        << "    \"min_time\": " << options.minTime << "\n  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &r = results[i];
+        double pairs = (double)r.V * (r.V - 1) / 2;
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "    {\"name\": \"%s\", \"V\": %d, \"E\": %lld, \"density\": %.6g, \"seed\": %d, "
+                 "\"iterations\": %lld, \"real_time\": %.6g, \"cpu_time\": %.6g, \"time_unit\": \"ns\", "
+                 "\"edges_per_second\": %.6g, \"allocs_per_iter\": %.6g, \"bytes_per_iter\": %.6g}%s\n",
+                 r.name.c_str(), r.V, r.E, pairs > 0 ? r.E / pairs : 0.0, r.seed, r.iterations, r.realNs,
+                 r.cpuNs, r.E * 1e9 / r.realNs, r.allocs, r.bytes, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+// ================= Sweeps =================
+struct Size
+{
+    int V;
+    long long E;
+};
+
+const int SEED = 1;
+const int MAX_WEIGHT = 100; // weighted, so the MST benchmarks sort edges
+
+// Average degree 4 and 16 at three scales, plus a half-dense graph
+const Size LINEAR_SIZES[] = {{1000, 2000}, {1000, 8000}, {10000, 20000}, {10000, 80000},
+                             {100000, 200000}, {100000, 800000}, {1000, 249750}};
+// Random graphs almost never have all degrees even; complete graphs on an
+// odd number of vertices do, so these run the whole circuit construction
+const Size EULERIAN_SIZES[] = {{101, 5050}, {501, 125250}, {1001, 500500}};
+const Size CLIQUE_SIZES[] = {{50, 250}, {50, 600}, {100, 2475}, {1000, 8000}, {100000, 800000}};
+// Held-Karp handles V up to 24; hamiltonUtil backtracks above that
+const Size HELD_KARP_SIZES[] = {{16, 40}, {20, 60}, {24, 80}};
+// Sparser graphs than these mostly fail the degree or biconnectivity test
+// before any backtracking
+const Size BACKTRACK_SIZES[] = {{100, 400}, {200, 1200}, {400, 4000}, {1000, 10000}};
+
+void runAll()
+{
+    for (const Size &s : LINEAR_SIZES)
+        measure("generate", s.V, s.E, SEED, [&] { keep(GraphGenerator::generate(s.V, s.E, SEED, MAX_WEIGHT)); });
+
+    for (const Size &s : LINEAR_SIZES)
+    {
+        Graph g = GraphGenerator::generate(s.V, s.E, SEED, MAX_WEIGHT);
+        measure("isConnected", s.V, s.E, SEED, [&] { keep(g.isConnected()); });
+        measure("findMSTWeight", s.V, s.E, SEED, [&] { keep(g.findMSTWeight()); });
+        measure("findSCCGroups", s.V, s.E, SEED, [&] { keep(g.findSCCGroups()); });
+    }
+    for (const Size &s : EULERIAN_SIZES)
+    {
+        Graph g = GraphGenerator::generate(s.V, s.E, SEED);
+        measure("findEulerianCircuit", s.V, s.E, SEED, [&] { keep(g.findEulerianCircuit()); });
+    }
+
+    Deadline none;
+    bool complete;
+    for (const Size &s : CLIQUE_SIZES)
+    {
+        Graph g = GraphGenerator::generate(s.V, s.E, SEED);
+        measure("countCliques", s.V, s.E, SEED, [&] { keep(g.countCliques(none, complete)); });
+        measure("countMaximalCliques", s.V, s.E, SEED, [&] { keep(g.countCliques(none, complete, true)); });
+    }
+    for (const Size &s : HELD_KARP_SIZES)
+    {
+        Graph g = GraphGenerator::generate(s.V, s.E, SEED);
+        measure("heldKarpCircuit", s.V, s.E, SEED, [&] { keep(g.findHamiltonianCircuit(none, complete)); });
+    }
+    for (const Size &s : BACKTRACK_SIZES)
+    {
+        Graph g = GraphGenerator::generate(s.V, s.E, SEED);
+        measure("hamiltonUtil", s.V, s.E, SEED, [&] { keep(g.findHamiltonianCircuit(none, complete)); });
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Single-threaded by default so numbers do not depend on the machine's
+    // core count; -p opts into the parallel BFS and MST paths
+    Graph::parallelThreads() = 1;
+    int option;
+    while ((option = getopt(argc, argv, "p:t:f:o:")) != -1)
+    {
+        switch (option)
+        {
+        case 'p':
+            Graph::parallelThreads() = std::max(1, std::stoi(optarg));
+            break;
+        case 't':
+            options.minTime = std::stod(optarg);
+            break;
+        case 'f':
+            options.filter = optarg;
+            break;
+        case 'o':
+            options.jsonPath = optarg;
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0]
+                      << " [-p <threads>] [-t <min seconds>] [-f <name filter>] [-o <json file>]\n";
+            return 1;
+        }
+    }
+
+    printf("%-44s %14s %14s %10s %12s %10s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "Edges/s",
+           "Allocs/op");
+    runAll();
+    if (options.jsonPath)
+        writeJson(options.jsonPath);
+    return 0;
+}
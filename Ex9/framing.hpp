@@ -0,0 +1,717 @@
+#ifndef FRAMING_HPP
+#define FRAMING_HPP
+
+// ================= Wire Protocol =================
+// Every message is a frame: a 4-byte length counting the bytes after it, a
+// 4-byte request id, a 4-byte opcode (requests) or status (responses), then
+// the payload. A connection carries any number of frames and a client may
+// send several requests before reading; each response carries the id of its
+// request, and responses may come back in any order.
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+struct FrameHeader
+{
+    uint32_t length;
+    uint32_t requestId;
+    uint32_t code;
+};
+
+const size_t FRAME_HEADER_TAIL = sizeof(FrameHeader) - sizeof(uint32_t); // id + code
+const uint32_t OP_ALGORITHMS = 1;        // payload: V, E, seed, maxWeight[, deadline ms]
+const uint32_t OP_ALGORITHMS_BINARY = 2; // same payload, packed results (below)
+const uint32_t OP_STATS = 3;             // no payload; answers with the metrics as Prometheus text
+const uint32_t STATUS_OK = 0;
+const uint32_t STATUS_ERROR = 1;
+// The deadline stopped a search: a clique count is a lower bound and the
+// Hamiltonian result is unknown (text says so; binary clears their bits in
+// the completeness varint)
+const uint32_t STATUS_PARTIAL = 2;
+const uint32_t MAX_REQUEST_FRAME = 4096;
+
+// Takes the next complete frame from in[pos...]: returns 1 and moves pos past
+// it, 0 when more bytes are needed, -1 when the length field is below the
+// header or above maxLength
+inline int parseFrame(const std::string &in, size_t &pos, FrameHeader &header, const char *&payload,
+                      size_t &payloadBytes, uint32_t maxLength)
+{
+    if (in.size() - pos < sizeof(FrameHeader))
+        return 0;
+    memcpy(&header, in.data() + pos, sizeof(header));
+    if (header.length < FRAME_HEADER_TAIL || header.length > maxLength)
+        return -1;
+    size_t frameBytes = sizeof(uint32_t) + header.length;
+    if (in.size() - pos < frameBytes)
+        return 0;
+    payload = in.data() + pos + sizeof(FrameHeader);
+    payloadBytes = header.length - FRAME_HEADER_TAIL;
+    pos += frameBytes;
+    return 1;
+}
+
+// ================= Response Buffers =================
+// Output is formatted straight into fixed-size chunks: integers with
+// std::to_chars, text with memcpy. Chunks come from a process-wide free list
+// and go back to it once the socket has taken their bytes, and FrameQueue
+// hands them to sendmsg() as they are. A large response therefore costs no
+// reallocation, no temporary strings and no copy between formatting and the
+// kernel. A finished buffer can also be shared (see share()): other buffers
+// then reference its bytes in place, which is how cached results are sent.
+const size_t CHUNK_SIZE = 16 * 1024;
+
+class ChunkPool
+{
+    static const size_t MAX_FREE = 1024;
+    std::mutex m;
+    std::vector<char *> freeChunks;
+
+public:
+    // Never destroyed: buffers in static objects may release chunks at exit
+    static ChunkPool &instance()
+    {
+        static ChunkPool *pool = new ChunkPool;
+        return *pool;
+    }
+
+    char *take()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (!freeChunks.empty())
+            {
+                char *chunk = freeChunks.back();
+                freeChunks.pop_back();
+                return chunk;
+            }
+        }
+        return new char[CHUNK_SIZE];
+    }
+
+    void give(char *chunk)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (freeChunks.size() < MAX_FREE)
+            {
+                freeChunks.push_back(chunk);
+                return;
+            }
+        }
+        delete[] chunk;
+    }
+};
+
+class ResponseBuffer
+{
+    struct ChunkRelease
+    {
+        void operator()(char *chunk) const { ChunkPool::instance().give(chunk); }
+    };
+
+    // Bytes in a pooled chunk this buffer writes to, or (chunk null) bytes
+    // someone else owns and shared keeps alive; only the former grow
+    struct Piece
+    {
+        const char *data;
+        size_t used;
+        std::unique_ptr<char[], ChunkRelease> chunk;
+        std::shared_ptr<const void> shared;
+    };
+
+    // Shared results up to this size are copied into one exact-size block
+    // instead of holding on to a whole chunk
+    static const size_t COMPACT_SHARE_BYTES = CHUNK_SIZE / 4;
+
+    std::vector<Piece> pieces;
+    size_t total = 0;
+
+    size_t tailRoom() const
+    {
+        return pieces.empty() || !pieces.back().chunk ? 0 : CHUNK_SIZE - pieces.back().used;
+    }
+
+    // Returns room for n <= CHUNK_SIZE contiguous bytes at the end of the
+    // last chunk, starting a new chunk if it lacks them
+    char *reserve(size_t n)
+    {
+        if (tailRoom() < n)
+        {
+            char *chunk = ChunkPool::instance().take();
+            pieces.push_back({chunk, 0, std::unique_ptr<char[], ChunkRelease>(chunk), nullptr});
+        }
+        return pieces.back().chunk.get() + pieces.back().used;
+    }
+
+    void commit(size_t n)
+    {
+        pieces.back().used += n;
+        total += n;
+    }
+
+public:
+    ResponseBuffer() = default;
+    ResponseBuffer(const std::string &text) { *this << text; }
+    ResponseBuffer(const char *text) { *this << text; }
+
+    size_t size() const { return total; }
+
+    // Heap bytes this buffer holds on its own: whole chunks, or the bytes of
+    // a compacted share
+    size_t memoryBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &p : pieces)
+            bytes += p.chunk ? CHUNK_SIZE : p.used;
+        return bytes;
+    }
+
+    // Turns buffer, left empty, into an immutable buffer that append() can
+    // reference from any number of others at once
+    static std::shared_ptr<const ResponseBuffer> share(ResponseBuffer &&buffer)
+    {
+        auto shared = std::make_shared<ResponseBuffer>();
+        if (buffer.total <= COMPACT_SHARE_BYTES)
+        {
+            std::shared_ptr<char> block(new char[buffer.total + 1], std::default_delete<char[]>());
+            size_t at = 0;
+            for (const auto &p : buffer.pieces)
+            {
+                memcpy(block.get() + at, p.data, p.used);
+                at += p.used;
+            }
+            shared->pieces.push_back({block.get(), at, nullptr, block});
+            shared->total = at;
+        }
+        else
+        {
+            shared->pieces.swap(buffer.pieces);
+            shared->total = buffer.total;
+        }
+        buffer.pieces.clear();
+        buffer.total = 0;
+        return shared;
+    }
+    ResponseBuffer &operator<<(std::string_view text)
+    {
+        while (!text.empty())
+        {
+            size_t room = tailRoom();
+            size_t n = std::min(text.size(), room == 0 ? CHUNK_SIZE : room);
+            memcpy(reserve(n), text.data(), n);
+            commit(n);
+            text.remove_prefix(n);
+        }
+        return *this;
+    }
+
+    ResponseBuffer &operator<<(const char *text) { return *this << std::string_view(text); }
+    ResponseBuffer &operator<<(const std::string &text) { return *this << std::string_view(text); }
+
+    ResponseBuffer &operator<<(char c)
+    {
+        *reserve(1) = c;
+        commit(1);
+        return *this;
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    ResponseBuffer &operator<<(T value)
+    {
+        char *at = reserve(24);
+        commit(std::to_chars(at, at + 24, value).ptr - at);
+        return *this;
+    }
+
+    // Appends other, leaving it empty. Short buffers are copied into the
+    // last chunk; longer ones hand over their chunks without copying.
+    void append(ResponseBuffer &&other)
+    {
+        if (other.total <= tailRoom())
+        {
+            for (auto &p : other.pieces)
+                *this << std::string_view(p.data, p.used);
+        }
+        else
+        {
+            for (auto &p : other.pieces)
+                pieces.push_back(std::move(p));
+            total += other.total;
+        }
+        other.pieces.clear();
+        other.total = 0;
+    }
+
+    // Appends the bytes of a shared buffer: copied when they fit the last
+    // chunk, otherwise referenced in place and kept alive by this buffer
+    void append(const std::shared_ptr<const ResponseBuffer> &other)
+    {
+        if (other->total <= tailRoom())
+        {
+            for (const auto &p : other->pieces)
+                *this << std::string_view(p.data, p.used);
+            return;
+        }
+        for (const auto &p : other->pieces)
+            pieces.push_back({p.data, p.used, nullptr, other});
+        total += other->total;
+    }
+
+    // Adds iovecs for the bytes from offset on to iov[count...], at most
+    // limit entries in all; returns the new count
+    int gather(size_t offset, iovec *iov, int count, int limit) const
+    {
+        for (const auto &p : pieces)
+        {
+            if (count == limit)
+                break;
+            if (offset >= p.used)
+            {
+                offset -= p.used;
+                continue;
+            }
+            iov[count++] = {const_cast<char *>(p.data) + offset, p.used - offset};
+            offset = 0;
+        }
+        return count;
+    }
+
+    std::string str() const
+    {
+        std::string s;
+        s.reserve(total);
+        for (const auto &p : pieces)
+            s.append(p.data, p.used);
+        return s;
+    }
+};
+
+// ================= Binary Results =================
+// OP_ALGORITHMS_BINARY takes the same payload as OP_ALGORITHMS and answers
+// with the five results packed instead of as text, in the same order, after
+// a varint whose bit i is set when result i is complete (the deadline can
+// cut the clique count, leaving a lower bound, and the Hamiltonian search,
+// leaving no circuit):
+//   Eulerian circuit     vertex sequence
+//   MST weight           8-byte integer
+//   clique count         8-byte integer
+//   components           varint V, varint k, then each vertex's component
+//                        index in bitsFor(k) bits, least significant first
+//   Hamiltonian circuit  vertex sequence, closing vertex not repeated
+// A vertex sequence is a varint length, the first vertex as a varint, then
+// every step as a zigzag varint delta; length 0 means there is none. Fixed
+// integers are little-endian like the frame header. Components are numbered
+// in order of their smallest vertex, which is also the order of the text.
+
+// Bit positions in the completeness varint
+enum ResultIndex { RESULT_EULER, RESULT_MST, RESULT_CLIQUES, RESULT_SCC, RESULT_HAMILTON, RESULT_COUNT };
+
+// Bits per component index when there are k components
+inline int bitsFor(uint64_t k)
+{
+    int bits = 0;
+    while (k > 1 && ((k - 1) >> bits) != 0)
+        ++bits;
+    return bits;
+}
+
+inline void putVarint(ResponseBuffer &out, uint64_t v)
+{
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        buf[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (char)v;
+    out << std::string_view(buf, n);
+}
+
+// The completeness varint from one flag per result
+inline uint64_t completeMask(const bool (&complete)[RESULT_COUNT])
+{
+    uint64_t mask = 0;
+    for (int i = 0; i < RESULT_COUNT; ++i)
+        mask |= (uint64_t)complete[i] << i;
+    return mask;
+}
+
+// Joins the five results of a request in order into out: text ones each
+// followed by a newline, binary ones after the completeness varint
+inline void joinResults(ResponseBuffer &out, ResponseBuffer (&parts)[RESULT_COUNT],
+                        const bool (&complete)[RESULT_COUNT], bool binary)
+{
+    if (binary)
+        putVarint(out, completeMask(complete));
+    for (auto &part : parts)
+    {
+        out.append(std::move(part));
+        if (!binary)
+            out << '\n';
+    }
+}
+
+inline void putFixed64(ResponseBuffer &out, int64_t v)
+{
+    out << std::string_view(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+inline void putSequence(ResponseBuffer &out, const std::vector<int> &seq)
+{
+    putVarint(out, seq.size());
+    if (seq.empty())
+        return;
+    putVarint(out, (uint32_t)seq[0]);
+    for (size_t i = 1; i < seq.size(); ++i)
+    {
+        int64_t delta = (int64_t)seq[i] - seq[i - 1];
+        putVarint(out, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    }
+}
+
+inline void putLabels(ResponseBuffer &out, const std::vector<int> &label, int count)
+{
+    putVarint(out, label.size());
+    putVarint(out, count);
+    int bits = bitsFor(count);
+    if (bits == 0)
+        return;
+    char buf[4096];
+    size_t n = 0;
+    uint64_t acc = 0;
+    int held = 0;
+    for (int l : label)
+    {
+        acc |= (uint64_t)l << held;
+        held += bits;
+        while (held >= 8)
+        {
+            buf[n++] = (char)acc;
+            acc >>= 8;
+            held -= 8;
+            if (n == sizeof(buf))
+            {
+                out << std::string_view(buf, n);
+                n = 0;
+            }
+        }
+    }
+    if (held > 0)
+        buf[n++] = (char)acc;
+    out << std::string_view(buf, n);
+}
+
+// Reads the fields above from a response body; any overrun clears ok
+class BinaryReader
+{
+    const unsigned char *p;
+    const unsigned char *end;
+
+public:
+    bool ok = true;
+
+    explicit BinaryReader(const std::string &body)
+        : p(reinterpret_cast<const unsigned char *>(body.data())), end(p + body.size()) {}
+
+    bool atEnd() const { return p == end; }
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p == end)
+                break;
+            unsigned char b = *p++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t fixed64()
+    {
+        int64_t v = 0;
+        if (end - p < (long)sizeof(v))
+        {
+            ok = false;
+            return 0;
+        }
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+
+    std::vector<int> sequence()
+    {
+        uint64_t n = varint();
+        std::vector<int> seq;
+        if (!ok || n == 0 || n > (uint64_t)(end - p))
+        {
+            ok = ok && n == 0;
+            return seq;
+        }
+        seq.reserve(n);
+        int64_t v = (int64_t)varint();
+        seq.push_back((int)v);
+        for (uint64_t i = 1; i < n && ok; ++i)
+        {
+            uint64_t z = varint();
+            v += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+            seq.push_back((int)v);
+        }
+        return seq;
+    }
+
+    // maxV bounds the vertex count before anything is allocated: with one
+    // component the labels take no bytes, so the body cannot bound it
+    std::vector<int> labels(int &count, uint64_t maxV)
+    {
+        uint64_t V = varint();
+        uint64_t k = varint();
+        std::vector<int> label;
+        count = 0;
+        if (!ok || k > V || (k == 0) != (V == 0) || V > maxV)
+        {
+            ok = false;
+            return label;
+        }
+        count = (int)k;
+        int bits = bitsFor(count);
+        if ((uint64_t)(end - p) * 8 < V * bits)
+        {
+            ok = false;
+            return label;
+        }
+        label.resize(V);
+        uint64_t acc = 0, mask = (1ULL << bits) - 1;
+        int held = 0;
+        for (auto &l : label)
+        {
+            while (held < bits)
+            {
+                acc |= (uint64_t)*p++ << held;
+                held += 8;
+            }
+            l = (int)(acc & mask);
+            acc >>= bits;
+            held -= bits;
+            if (l >= count)
+                ok = false;
+        }
+        return label;
+    }
+};
+
+// Renders an OP_ALGORITHMS_BINARY body in the layout of the text results;
+// false if the body is malformed or names more than maxV vertices (the V of
+// the request)
+inline bool decodeResults(const std::string &body, std::string &text, int maxV)
+{
+    BinaryReader in(body);
+    uint64_t complete = in.varint();
+    std::vector<int> euler = in.sequence();
+    int64_t mst = in.fixed64();
+    int64_t cliques = in.fixed64();
+    int count;
+    std::vector<int> label = in.labels(count, maxV < 0 ? 0 : (uint64_t)maxV);
+    std::vector<int> hamilton = in.sequence();
+    if (!in.ok || !in.atEnd() || complete >= 1u << RESULT_COUNT)
+        return false;
+    bool cliquesComplete = complete & 1u << RESULT_CLIQUES;
+    bool hamiltonComplete = complete & 1u << RESULT_HAMILTON;
+
+    ResponseBuffer out;
+    if (euler.empty())
+        out << "No Eulerian Circuit";
+    else
+    {
+        out << "Eulerian Circuit: ";
+        for (int v : euler)
+            out << v << ' ';
+    }
+    out << '\n' << "MST weight: " << mst << '\n';
+    if (cliquesComplete)
+        out << "Number of Cliques: " << cliques << '\n';
+    else
+        out << "Number of Cliques: at least " << cliques << " (timed out)\n";
+
+    if (count == 0)
+        out << "No Strongly Connected Components found.";
+    else
+    {
+        std::vector<std::vector<int>> groups(count);
+        for (size_t v = 0; v < label.size(); ++v)
+            groups[label[v]].push_back(v);
+        out << "Strongly Connected Components:";
+        for (int i = 0; i < count; ++i)
+        {
+            out << "\nComponent " << i + 1 << ": ";
+            for (int v : groups[i])
+                out << v << ' ';
+        }
+    }
+    out << '\n';
+
+    if (!hamiltonComplete)
+        out << "Hamiltonian Circuit search timed out";
+    else if (hamilton.empty())
+        out << "Graph does not have a Hamiltonian Circuit";
+    else
+    {
+        out << "Hamiltonian Circuit: ";
+        for (int v : hamilton)
+            out << v << " -> ";
+        out << hamilton[0];
+    }
+    out << '\n';
+    text = out.str();
+    return true;
+}
+
+// ================= Outgoing Frames =================
+// Frames waiting to be written to one socket. A header and the chunks of its
+// body stay separate (the body is moved in, never copied behind the header)
+// and flush() gathers up to FLUSH_IOV pieces into one sendmsg(), so a header
+// and its body leave in one syscall and a short write resumes mid-piece.
+// sendmsg() is writev() plus flags: MSG_NOSIGNAL turns a vanished peer into
+// EPIPE instead of SIGPIPE. On a non-blocking socket flush() stops when the
+// kernel buffer is full; on a blocking one it returns once everything is out.
+class FrameQueue
+{
+    struct Frame
+    {
+        FrameHeader header;
+        ResponseBuffer body;
+        size_t sent = 0; // bytes of header + body already written
+    };
+
+    static const int FLUSH_IOV = 64;
+    std::deque<Frame> frames;
+
+public:
+    bool empty() const { return frames.empty(); }
+
+    void push(uint32_t requestId, uint32_t code, ResponseBuffer body)
+    {
+        Frame f;
+        f.header = {(uint32_t)(FRAME_HEADER_TAIL + body.size()), requestId, code};
+        f.body = std::move(body);
+        frames.push_back(std::move(f));
+    }
+
+    // Writes until the queue is empty or the socket would block; false on a
+    // socket error
+    bool flush(int fd)
+    {
+        while (!frames.empty())
+        {
+            iovec iov[FLUSH_IOV];
+            int count = 0;
+            for (size_t i = 0; i < frames.size() && count < FLUSH_IOV; ++i)
+            {
+                Frame &f = frames[i];
+                if (f.sent < sizeof(FrameHeader))
+                    iov[count++] = {(char *)&f.header + f.sent, sizeof(FrameHeader) - f.sent};
+                size_t bodySent = f.sent > sizeof(FrameHeader) ? f.sent - sizeof(FrameHeader) : 0;
+                count = f.body.gather(bodySent, iov, count, FLUSH_IOV);
+            }
+
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+
+            size_t left = n;
+            while (left > 0)
+            {
+                Frame &f = frames.front();
+                size_t remaining = sizeof(FrameHeader) + f.body.size() - f.sent;
+                if (left < remaining)
+                {
+                    f.sent += left;
+                    break;
+                }
+                left -= remaining;
+                frames.pop_front();
+            }
+        }
+        return true;
+    }
+};
+
+// ================= Incoming Frames =================
+// Blocking reader for a stream of frames. Every readv() fills the rest of
+// the current target and a spare buffer at once, so a header usually comes
+// in with the start of its body in one syscall; bytes read past the target
+// stay in spare for the next call. Bodies of any size are read in full.
+class FrameReader
+{
+    char spare[65536];
+    size_t begin = 0, end = 0;
+
+    bool fill(int fd, char *dst, size_t len)
+    {
+        size_t take = std::min(len, end - begin);
+        memcpy(dst, spare + begin, take);
+        begin += take;
+        dst += take;
+        len -= take;
+        while (len > 0)
+        {
+            begin = end = 0;
+            iovec iov[2] = {{dst, len}, {spare, sizeof(spare)}};
+            ssize_t n = readv(fd, iov, 2);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            if ((size_t)n < len)
+            {
+                dst += n;
+                len -= n;
+            }
+            else
+            {
+                end = n - len;
+                len = 0;
+            }
+        }
+        return true;
+    }
+
+public:
+    // Reads the next frame; false if the connection ends first or the
+    // length field is malformed
+    bool next(int fd, FrameHeader &header, std::string &body)
+    {
+        if (!fill(fd, (char *)&header, sizeof(header)) || header.length < FRAME_HEADER_TAIL)
+            return false;
+        body.resize(header.length - FRAME_HEADER_TAIL);
+        return body.empty() || fill(fd, &body[0], body.size());
+    }
+};
+
+#endif
@@ -0,0 +1,106 @@
+// Round trips for the OP_ALGORITHMS_BINARY codecs in framing.hpp: encodes with
+// the writers the server uses, reads back with the client's BinaryReader and
+// exits non-zero on the first mismatch. Run with `make test`.
+#include <iostream>
+#include <random>
+#include <vector>
+#include "framing.hpp"
+
+static const unsigned SEED = 1;
+
+// ================= Sequences and Labels =================
+// No component (V = 0), one component (zero bits per label, so no label
+// bytes) and several, with V past a byte of labels
+static bool sequencesAndLabels()
+{
+    struct Case
+    {
+        int V, k;
+    };
+    const Case CASES[] = {{0, 0}, {1, 1}, {8, 1}, {9, 1}, {100, 1}, {9, 2}, {100, 3}, {1000, 37}, {1000, 1000}};
+    std::mt19937 rng(SEED);
+    for (const Case &c : CASES)
+    {
+        std::vector<int> label(c.V);
+        for (int v = 0; v < c.V; ++v)
+            label[v] = v < c.k ? v : (int)(rng() % c.k);
+        std::vector<int> seq(c.V);
+        for (int &v : seq)
+            v = (int)(rng() % (c.V + 1));
+
+        ResponseBuffer out;
+        putSequence(out, seq);
+        putLabels(out, label, c.k);
+        std::string body = out.str();
+        BinaryReader in(body);
+        int count;
+        bool ok = in.sequence() == seq;
+        ok = in.labels(count, c.V) == label && ok;
+        if (!ok || !in.ok || !in.atEnd() || count != c.k)
+        {
+            std::cerr << "Sequence and label round trip failed for V=" << c.V << " k=" << c.k << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// A one-component header naming more vertices than the request asked for
+// must fail before the label vector is sized, since the body is a few bytes
+// whatever V it claims
+static bool oversizedLabels()
+{
+    ResponseBuffer out;
+    putVarint(out, INT32_MAX);
+    putVarint(out, 1);
+    std::string body = out.str();
+    BinaryReader in(body);
+    int count;
+    if (!in.labels(count, 1000).empty() || in.ok)
+    {
+        std::cerr << "Labels past the requested V were accepted\n";
+        return false;
+    }
+    return true;
+}
+
+// ================= Completeness =================
+// A result the deadline cut short must decode the way the text formatter
+// writes it, not as a finished answer
+static bool completeness()
+{
+    for (bool finished : {true, false})
+    {
+        bool complete[RESULT_COUNT] = {true, true, finished, true, finished};
+        ResponseBuffer out;
+        putVarint(out, completeMask(complete));
+        putSequence(out, {});
+        putFixed64(out, 7);
+        putFixed64(out, 42);
+        putLabels(out, {0, 0, 0}, 1);
+        putSequence(out, {});
+        std::string text;
+        if (!decodeResults(out.str(), text, 3))
+        {
+            std::cerr << "Completeness body rejected\n";
+            return false;
+        }
+        const char *cliques = finished ? "Number of Cliques: 42\n" : "Number of Cliques: at least 42 (timed out)\n";
+        const char *hamilton =
+            finished ? "Graph does not have a Hamiltonian Circuit\n" : "Hamiltonian Circuit search timed out\n";
+        if (text.find(cliques) == std::string::npos || text.find(hamilton) == std::string::npos)
+        {
+            std::cerr << "Decoded " << (finished ? "complete" : "partial") << " results read:\n" << text;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!sequencesAndLabels() || !oversizedLabels() || !completeness())
+        return 1;
+    std::cout << "framing_test: all passed\n";
+    return 0;
+}
@@ -0,0 +1,576 @@
+// Load generator for the graph servers. Opens N connections and drives a
+// mix of (V, E, seed, algorithm) jobs at them, either closed-loop (every
+// connection keeps a fixed number of requests outstanding) or open-loop (a
+// fixed total request rate, whatever the server does). Latencies go into
+// HDR-style histograms; the summary gives throughput and p50/p90/p99/p99.9.
+//
+// -P 7 speaks Ex7's protocol (raw ints, one algorithm per request, replies
+// in order); -P 9, the default, speaks the framed protocol of Ex8 and Ex9,
+// which runs all five algorithms per request and ignores the algorithm.
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "framing.hpp"
+
+#define PORT 8080
+
+using Clock = std::chrono::steady_clock;
+
+// ================= Latency Histogram =================
+// Log-linear buckets in the manner of HdrHistogram: values below 256 us are
+// counted exactly, above that every power of two is split into 128 buckets,
+// so a reported value is within 1% of the true one all the way up to 2^40
+// us. Counters are atomic; every connection records into the same ones.
+class LatencyHistogram
+{
+    static const int SUB_BITS = 7;
+    static const uint64_t SUB_COUNT = 1 << SUB_BITS;
+    static const int MAX_BITS = 40;
+    static const int BUCKETS = 2 * SUB_COUNT + (MAX_BITS - SUB_BITS - 1) * SUB_COUNT;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> counts{new std::atomic<uint64_t>[BUCKETS]()};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maxValue{0};
+
+    static int indexOf(uint64_t v)
+    {
+        if (v < 2 * SUB_COUNT)
+            return (int)v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return (int)(2 * SUB_COUNT + (msb - SUB_BITS - 1) * SUB_COUNT + ((v >> shift) - SUB_COUNT));
+    }
+
+    // Largest value that lands in bucket index
+    static uint64_t highestIn(int index)
+    {
+        if (index < (int)(2 * SUB_COUNT))
+            return index;
+        int k = index - 2 * SUB_COUNT;
+        int shift = k / SUB_COUNT + 1;
+        return ((SUB_COUNT + k % SUB_COUNT + 1) << shift) - 1;
+    }
+
+public:
+    void record(uint64_t us)
+    {
+        us = std::min<uint64_t>(us, (1ULL << MAX_BITS) - 1);
+        counts[indexOf(us)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(us, std::memory_order_relaxed);
+        uint64_t seen = maxValue.load(std::memory_order_relaxed);
+        while (us > seen && !maxValue.compare_exchange_weak(seen, us, std::memory_order_relaxed))
+            ;
+    }
+
+    uint64_t count() const { return total.load(); }
+    uint64_t max() const { return maxValue.load(); }
+    double mean() const { return total.load() ? (double)sum.load() / total.load() : 0; }
+
+    // Smallest recorded value (to bucket precision) that at least percent
+    // of the samples do not exceed
+    uint64_t percentile(double percent) const
+    {
+        uint64_t n = total.load();
+        if (n == 0)
+            return 0;
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)(percent / 100 * n + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= target)
+                return std::min(highestIn(i), max());
+        }
+        return max();
+    }
+};
+
+// ================= Workload =================
+struct Job
+{
+    int V, E, seed, algoCode, maxWeight;
+    LatencyHistogram latency;
+};
+
+enum Protocol
+{
+    PROTOCOL_EX7 = 7,
+    PROTOCOL_FRAMED = 9
+};
+
+struct Options
+{
+    const char *host = "127.0.0.1";
+    int port = PORT;
+    Protocol protocol = PROTOCOL_FRAMED;
+    int connections = 4;
+    double rate = 0;     // total requests per second; 0 runs closed-loop
+    int depth = 1;       // closed-loop requests outstanding per connection
+    double duration = 10; // seconds of sending, warm-up included
+    double warmup = 0;   // seconds whose requests are not recorded
+    bool freshSeeds = false;
+    bool binary = false;
+    int deadlineMs = 0;
+    const char *jsonPath = nullptr;
+};
+
+Options options;
+std::vector<std::unique_ptr<Job>> mix;
+LatencyHistogram overall;
+std::atomic<uint64_t> sent{0}, completed{0}, failed{0}, partial{0}, rejected{0}, unanswered{0};
+std::atomic<uint64_t> nextFreshSeed{0};
+Clock::time_point startTime, measureFrom, sendUntil;
+std::atomic<int64_t> lastCompletionNs{0}; // since startTime
+
+// Reads "V:E:seed:algo[:maxWeight]"; false if malformed
+bool parseJob(const char *spec)
+{
+    int values[5] = {0, 0, 0, 0, 1};
+    int n = 0;
+    std::stringstream in(spec);
+    std::string field;
+    while (n < 5 && std::getline(in, field, ':'))
+        values[n++] = atoi(field.c_str());
+    if (n < 4 || in.rdbuf()->in_avail() > 0 || values[0] <= 0 || values[1] < 0)
+        return false;
+    std::unique_ptr<Job> job(new Job);
+    job->V = values[0];
+    job->E = values[1];
+    job->seed = values[2];
+    job->algoCode = values[3];
+    job->maxWeight = std::max(1, values[4]);
+    mix.push_back(std::move(job));
+    return true;
+}
+
+// ================= Connection =================
+// Two threads per connection: the sender paces requests and the receiver
+// matches replies to them. A request's latency runs from the moment it was
+// due, not the moment it left, so in open-loop mode a sender stalled by a
+// full socket does not hide the queueing it caused (coordinated omission).
+class LoadConnection
+{
+    struct InFlight
+    {
+        Clock::time_point due;
+        int job;
+    };
+
+    int index;
+    int sock = -1;
+    std::mutex m;
+    std::condition_variable cv;
+    std::map<uint32_t, InFlight> inFlight; // by request id, which only grows
+    bool sending = true;
+    std::thread sender, receiver;
+
+    std::string encode(uint32_t id, const Job &job)
+    {
+        int seed = job.seed + (options.freshSeeds ? (int)nextFreshSeed.fetch_add(1) : 0);
+        if (options.protocol == PROTOCOL_EX7)
+        {
+            int data[5] = {job.V, job.E, seed, job.maxWeight, job.algoCode};
+            return std::string(reinterpret_cast<const char *>(data), sizeof(data));
+        }
+        int data[5] = {job.V, job.E, seed, job.maxWeight, options.deadlineMs};
+        FrameHeader header = {(uint32_t)(FRAME_HEADER_TAIL + sizeof(data)), id,
+                              options.binary ? OP_ALGORITHMS_BINARY : OP_ALGORITHMS};
+        std::string frame(reinterpret_cast<const char *>(&header), sizeof(header));
+        frame.append(reinterpret_cast<const char *>(data), sizeof(data));
+        return frame;
+    }
+
+    void sendLoop()
+    {
+        std::mt19937 rng(index + 1); // the same job sequence on every run
+        std::uniform_int_distribution<int> pick(0, mix.size() - 1);
+        Clock::duration interval{};
+        Clock::time_point due = startTime;
+        if (options.rate > 0)
+        {
+            // Connections take turns, so the total rate is spread evenly
+            interval = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(options.connections / options.rate));
+            due += std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(index / options.rate));
+        }
+
+        for (uint32_t id = 1;; ++id)
+        {
+            if (options.rate > 0 && due < sendUntil)
+                std::this_thread::sleep_until(due);
+            std::unique_lock<std::mutex> lock(m);
+            if (options.rate <= 0)
+            {
+                cv.wait_until(lock, sendUntil, [this] { return !sending || (int)inFlight.size() < options.depth; });
+                due = Clock::now();
+            }
+            if (!sending || due >= sendUntil)
+                break;
+            int job = pick(rng);
+            inFlight[id] = {due, job};
+            lock.unlock();
+
+            std::string request = encode(id, *mix[job]);
+            if (!sendAll(request.data(), request.size()))
+                break;
+            sent.fetch_add(1, std::memory_order_relaxed);
+            due += interval;
+        }
+
+        std::lock_guard<std::mutex> lock(m);
+        sending = false;
+        shutdown(sock, SHUT_WR); // the server answers what it has, then closes
+    }
+
+    bool sendAll(const char *p, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    bool readFull(void *buf, size_t len)
+    {
+        char *p = static_cast<char *>(buf);
+        while (len > 0)
+        {
+            ssize_t n = read(sock, p, len);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Reads the next reply; id is 0 for Ex7, which answers in order.
+    // refused is set for an admission rejection, which every server sends
+    // as "Rejected: ..." text (under STATUS_ERROR when framed)
+    bool readReply(FrameReader &reader, uint32_t &id, uint32_t &status, bool &refused)
+    {
+        std::string body;
+        if (options.protocol == PROTOCOL_FRAMED)
+        {
+            FrameHeader header;
+            if (!reader.next(sock, header, body))
+                return false;
+            id = header.requestId;
+            status = header.code;
+            refused = status == STATUS_ERROR && body.compare(0, 9, "Rejected:") == 0;
+            return true;
+        }
+        int size = 0;
+        if (!readFull(&size, sizeof(size)) || size <= 0)
+            return false;
+        body.resize(size);
+        if (!readFull(&body[0], size))
+            return false;
+        id = 0;
+        refused = body.compare(0, 9, "Rejected:") == 0;
+        if (refused)
+            status = STATUS_ERROR;
+        else
+            status = body.find("timed out") != std::string::npos ? STATUS_PARTIAL : STATUS_OK;
+        return true;
+    }
+
+    void receiveLoop()
+    {
+        FrameReader reader;
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (!sending && inFlight.empty())
+                    break;
+            }
+            uint32_t id, status;
+            bool refused;
+            if (!readReply(reader, id, status, refused))
+                break;
+            Clock::time_point now = Clock::now();
+
+            InFlight request;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                auto it = id == 0 ? inFlight.begin() : inFlight.find(id);
+                if (it == inFlight.end())
+                {
+                    std::cerr << "Connection " << index << ": reply to unknown request " << id << "\n";
+                    break;
+                }
+                request = it->second;
+                inFlight.erase(it);
+            }
+            cv.notify_one();
+
+            if (status == STATUS_ERROR)
+                (refused ? rejected : failed).fetch_add(1, std::memory_order_relaxed);
+            else if (status == STATUS_PARTIAL)
+                partial.fetch_add(1, std::memory_order_relaxed);
+            completed.fetch_add(1, std::memory_order_relaxed);
+            if (request.due >= measureFrom)
+            {
+                uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - request.due).count();
+                overall.record(us);
+                mix[request.job]->latency.record(us);
+                int64_t at = std::chrono::duration_cast<std::chrono::nanoseconds>(now - startTime).count();
+                int64_t last = lastCompletionNs.load(std::memory_order_relaxed);
+                while (at > last && !lastCompletionNs.compare_exchange_weak(last, at))
+                    ;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m);
+        unanswered.fetch_add(inFlight.size());
+        inFlight.clear();
+        sending = false;
+        cv.notify_one();
+    }
+
+public:
+    explicit LoadConnection(int index) : index(index) {}
+
+    ~LoadConnection()
+    {
+        if (sock >= 0)
+            close(sock);
+    }
+
+    bool open()
+    {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0)
+            return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options.port);
+        if (inet_pton(AF_INET, options.host, &addr.sin_addr) != 1)
+            return false;
+        // A server that stops answering fails the run instead of hanging it
+        timeval timeout{60, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        return connect(sock, (sockaddr *)&addr, sizeof(addr)) == 0;
+    }
+
+    void start()
+    {
+        receiver = std::thread(&LoadConnection::receiveLoop, this);
+        sender = std::thread(&LoadConnection::sendLoop, this);
+    }
+
+    void join()
+    {
+        sender.join();
+        receiver.join();
+    }
+};
+
+// ================= Report =================
+const double PERCENTILES[] = {50, 90, 99, 99.9};
+
+double measuredSeconds()
+{
+    double seconds = lastCompletionNs.load() * 1e-9 - options.warmup;
+    return seconds > 0 ? seconds : 0;
+}
+
+void printLatency(const char *label, const LatencyHistogram &h)
+{
+    printf("%-32s %9llu %10.3f", label, (unsigned long long)h.count(), h.mean() / 1000);
+    for (double p : PERCENTILES)
+        printf(" %10.3f", h.percentile(p) / 1000.0);
+    printf(" %10.3f\n", h.max() / 1000.0);
+}
+
+void printReport()
+{
+    double seconds = measuredSeconds();
+    printf("\nRequests: %llu sent, %llu answered, %llu partial, %llu rejected, %llu failed, %llu unanswered\n",
+           (unsigned long long)sent.load(), (unsigned long long)completed.load(),
+           (unsigned long long)partial.load(), (unsigned long long)rejected.load(),
+           (unsigned long long)failed.load(), (unsigned long long)unanswered.load());
+    printf("Throughput: %.1f requests/s over %.2f s\n\n", seconds > 0 ? overall.count() / seconds : 0, seconds);
+    printf("%-32s %9s %10s %10s %10s %10s %10s %10s\n", "Latency (ms)", "Count", "Mean", "p50", "p90", "p99",
+           "p99.9", "Max");
+    printLatency("all", overall);
+    if (mix.size() > 1)
+        for (const auto &job : mix)
+        {
+            char label[64];
+            snprintf(label, sizeof(label), "V=%d E=%d seed=%d algo=%d", job->V, job->E, job->seed, job->algoCode);
+            printLatency(label, job->latency);
+        }
+}
+
+void writeLatency(std::ostream &out, const LatencyHistogram &h)
+{
+    out << "\"count\": " << h.count() << ", \"mean_us\": " << h.mean() << ", \"p50_us\": " << h.percentile(50)
+        << ", \"p90_us\": " << h.percentile(90) << ", \"p99_us\": " << h.percentile(99)
+        << ", \"p999_us\": " << h.percentile(99.9) << ", \"max_us\": " << h.max();
+}
+
+void writeJson(const char *path)
+{
+    std::ofstream out(path);
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    double seconds = measuredSeconds();
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"protocol\": " << options.protocol << ",\n"
+        << "    \"connections\": " << options.connections << ",\n"
+        << "    \"mode\": \"" << (options.rate > 0 ? "open" : "closed") << "\",\n"
+        << "    \"rate\": " << options.rate << ",\n"
+        << "    \"depth\": " << options.depth << ",\n"
+        << "    \"duration\": " << options.duration << ",\n"
+        << "    \"warmup\": " << options.warmup << "\n  },\n"
+        << "  \"sent\": " << sent << ", \"answered\": " << completed << ", \"partial\": " << partial
+        << ", \"rejected\": " << rejected << ", \"failed\": " << failed << ", \"unanswered\": " << unanswered
+        << ",\n  \"throughput\": " << (seconds > 0 ? overall.count() / seconds : 0) << ",\n  \"latency\": {";
+    writeLatency(out, overall);
+    out << "},\n  \"jobs\": [\n";
+    for (size_t i = 0; i < mix.size(); ++i)
+    {
+        const Job &job = *mix[i];
+        out << "    {\"V\": " << job.V << ", \"E\": " << job.E << ", \"seed\": " << job.seed
+            << ", \"algo\": " << job.algoCode << ", \"max_weight\": " << job.maxWeight << ", ";
+        writeLatency(out, job.latency);
+        out << "}" << (i + 1 < mix.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+    while ((option = getopt(argc, argv, "a:p:P:c:r:q:t:w:j:nbd:o:")) != -1)
+    {
+        bool ok = true;
+        switch (option)
+        {
+        case 'a':
+            options.host = optarg;
+            break;
+        case 'p':
+            options.port = atoi(optarg);
+            break;
+        case 'P':
+            options.protocol = atoi(optarg) == 7 ? PROTOCOL_EX7 : PROTOCOL_FRAMED;
+            ok = atoi(optarg) == 7 || atoi(optarg) == 8 || atoi(optarg) == 9;
+            break;
+        case 'c':
+            options.connections = atoi(optarg);
+            ok = options.connections > 0;
+            break;
+        case 'r':
+            options.rate = atof(optarg);
+            break;
+        case 'q':
+            options.depth = atoi(optarg);
+            ok = options.depth > 0;
+            break;
+        case 't':
+            options.duration = atof(optarg);
+            break;
+        case 'w':
+            options.warmup = atof(optarg);
+            break;
+        case 'j':
+            ok = parseJob(optarg);
+            break;
+        case 'n':
+            options.freshSeeds = true;
+            break;
+        case 'b':
+            options.binary = true;
+            break;
+        case 'd':
+            options.deadlineMs = atoi(optarg);
+            break;
+        case 'o':
+            options.jsonPath = optarg;
+            break;
+        default:
+            ok = false;
+        }
+        if (!ok)
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-a <address>] [-p <port>] [-P 7|8|9] [-c <connections>]\n"
+                         "       [-r <requests/s> | -q <outstanding per connection>] [-t <seconds>]\n"
+                         "       [-w <warm-up seconds>] [-j V:E:seed:algo[:maxWeight]]... [-n] [-b]\n"
+                         "       [-d <deadline ms>] [-o <json file>]\n";
+            return 1;
+        }
+    }
+    if (mix.empty())
+    {
+        // The five Ex7 algorithms on one small graph, Hamiltonian on a
+        // smaller one so Held-Karp answers it
+        for (const char *spec : {"200:800:1:1", "200:800:1:2:100", "200:800:1:3", "200:800:1:4", "20:60:1:5"})
+            parseJob(spec);
+    }
+
+    std::vector<std::unique_ptr<LoadConnection>> conns;
+    for (int i = 0; i < options.connections; ++i)
+    {
+        conns.emplace_back(new LoadConnection(i));
+        if (!conns.back()->open())
+        {
+            std::cerr << "Connection " << i << " failed\n";
+            return 1;
+        }
+    }
+
+    char mode[64];
+    if (options.rate > 0)
+        snprintf(mode, sizeof(mode), "open loop at %g requests/s", options.rate);
+    else
+        snprintf(mode, sizeof(mode), "closed loop, %d outstanding each", options.depth);
+    printf("%d connections, %s, %zu jobs in the mix, %.1f s (%.1f s warm-up)\n", options.connections, mode,
+           mix.size(), options.duration, options.warmup);
+    fflush(stdout);
+
+    startTime = Clock::now();
+    measureFrom = startTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+    sendUntil = startTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    for (auto &c : conns)
+        c->start();
+    for (auto &c : conns)
+        c->join();
+
+    printReport();
+    if (options.jsonPath)
+        writeJson(options.jsonPath);
+    return 0;
+}
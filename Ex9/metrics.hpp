@@ -0,0 +1,186 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "framing.hpp"
+
+// ================= Metrics =================
+// Latency histograms per request stage and request counts per status,
+// served as Prometheus text by OP_STATS. Every thread records into a slot
+// of its own, so a sample is a few relaxed loads and stores on counters
+// no other thread writes: no lock and no contended read-modify-write. A
+// scrape sums the slots. A slot outlives its thread: on exit it goes back
+// to a free list with its counts, and the next new thread carries on in it.
+class Metrics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Upper bounds 1 us * 4^k for k < BOUNDS (1 us to about 67 s), then +Inf
+    static constexpr int BOUNDS = 14;
+    static constexpr int BUCKETS = BOUNDS + 1;
+    static constexpr int STATUS_COUNT = 3; // STATUS_OK, STATUS_ERROR, STATUS_PARTIAL
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets; // stage * BUCKETS + bucket
+        std::unique_ptr<std::atomic<uint64_t>[]> sumNs;   // per stage
+        std::atomic<uint64_t> requests[STATUS_COUNT];
+
+        explicit Slot(size_t stages)
+            : buckets(new std::atomic<uint64_t>[stages * BUCKETS]()), sumNs(new std::atomic<uint64_t>[stages]()),
+              requests() {}
+    };
+
+    struct Handle
+    {
+        Metrics *owner = nullptr;
+        Slot *slot = nullptr;
+
+        ~Handle()
+        {
+            if (slot)
+                owner->release(slot);
+        }
+    };
+
+    std::vector<std::string> stages;
+    std::mutex m; // guards the slot lists, never a sample
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Slot *> freeSlots;
+
+    Slot *acquire()
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if (!freeSlots.empty())
+        {
+            Slot *slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        slots.emplace_back(new Slot(stages.size()));
+        return slots.back().get();
+    }
+
+    void release(Slot *slot)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        freeSlots.push_back(slot);
+    }
+
+    Slot &local()
+    {
+        thread_local Handle handle;
+        if (handle.owner != this)
+        {
+            if (handle.slot)
+                handle.owner->release(handle.slot);
+            handle.owner = this;
+            handle.slot = acquire();
+        }
+        return *handle.slot;
+    }
+
+    // Only the owning thread writes a slot, so a plain store of the loaded
+    // value plus n cannot lose an update
+    static void add(std::atomic<uint64_t> &counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static int bucketOf(uint64_t ns)
+    {
+        uint64_t us = (ns + 999) / 1000;
+        if (us <= 1)
+            return 0;
+        int log2Ceil = 64 - __builtin_clzll(us - 1);
+        return std::min((log2Ceil + 1) / 2, BOUNDS);
+    }
+
+public:
+    explicit Metrics(std::vector<std::string> stageNames) : stages(std::move(stageNames)) {}
+
+    void record(int stage, Clock::duration elapsed)
+    {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        Slot &slot = local();
+        add(slot.buckets[stage * BUCKETS + bucketOf(ns)], 1);
+        add(slot.sumNs[stage], ns);
+    }
+
+    void requestDone(uint32_t status)
+    {
+        if (status < (uint32_t)STATUS_COUNT)
+            add(local().requests[status], 1);
+    }
+
+    // Appends every stage histogram and the request counts
+    void write(ResponseBuffer &out)
+    {
+        static const char *STATUS_NAMES[STATUS_COUNT] = {"ok", "error", "partial"};
+        std::lock_guard<std::mutex> lock(m);
+        char line[160];
+        out << "# HELP graph_stage_seconds Time spent in each request stage\n"
+            << "# TYPE graph_stage_seconds histogram\n";
+        for (size_t s = 0; s < stages.size(); ++s)
+        {
+            const char *name = stages[s].c_str();
+            uint64_t count = 0;
+            for (int b = 0; b < BUCKETS; ++b)
+            {
+                uint64_t n = 0;
+                for (const auto &slot : slots)
+                    n += slot->buckets[s * BUCKETS + b].load(std::memory_order_relaxed);
+                count += n;
+                if (b < BOUNDS)
+                    snprintf(line, sizeof(line), "graph_stage_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n", name,
+                             1e-6 * (double)(1ULL << (2 * b)), (unsigned long long)count);
+                else
+                    snprintf(line, sizeof(line), "graph_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", name,
+                             (unsigned long long)count);
+                out << line;
+            }
+            uint64_t sumNs = 0;
+            for (const auto &slot : slots)
+                sumNs += slot->sumNs[s].load(std::memory_order_relaxed);
+            snprintf(line, sizeof(line), "graph_stage_seconds_sum{stage=\"%s\"} %.9f\n", name, sumNs * 1e-9);
+            out << line;
+            snprintf(line, sizeof(line), "graph_stage_seconds_count{stage=\"%s\"} %llu\n", name,
+                     (unsigned long long)count);
+            out << line;
+        }
+
+        out << "# HELP graph_requests_total Requests answered, by status\n"
+            << "# TYPE graph_requests_total counter\n";
+        for (int status = 0; status < STATUS_COUNT; ++status)
+        {
+            uint64_t n = 0;
+            for (const auto &slot : slots)
+                n += slot->requests[status].load(std::memory_order_relaxed);
+            out << "graph_requests_total{status=\"" << STATUS_NAMES[status] << "\"} " << n << '\n';
+        }
+    }
+};
+
+// Records the time from construction to destruction under stage
+class StageTimer
+{
+    Metrics &metrics;
+    int stage;
+    Metrics::Clock::time_point start = Metrics::Clock::now();
+
+public:
+    StageTimer(Metrics &metrics, int stage) : metrics(metrics), stage(stage) {}
+    ~StageTimer() { metrics.record(stage, Metrics::Clock::now() - start); }
+};
+
+#endif
@@ -1,449 +1,2404 @@
 #include <iostream>
 #include <thread>
 #include <vector>
+#include <cstdint>
+#include <climits>
+#include <atomic>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
-#include <set>
+#include <cmath>
 #include <sstream>
 #include <random>
+#include <chrono>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <algorithm>
-#include <stack>
 #include <functional>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "framing.hpp"
+#include "cache.hpp"
+#include "metrics.hpp"
 
 bool stopServer = false;
 int server_fd;
 
+// ================= Thread Team =================
+// A fixed group of threads that run one job together. run() hands job(id)
+// to every member (the calling thread is member 0) and returns when all of
+// them have finished; between runs the other members sleep.
+class ThreadTeam
+{
+    std::vector<std::thread> members;
+    std::mutex m;
+    std::condition_variable wake, done;
+    std::function<void(int)> job;
+    unsigned long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void loop(int id)
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            job(id);
+            std::lock_guard<std::mutex> lock(m);
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+public:
+    explicit ThreadTeam(int size)
+    {
+        for (int id = 1; id < size; ++id)
+            members.emplace_back(&ThreadTeam::loop, this, id);
+    }
+
+    ~ThreadTeam()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : members)
+            t.join();
+    }
+
+    int size() const { return (int)members.size() + 1; }
+
+    void run(std::function<void(int)> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = std::move(task);
+            pending = (int)members.size();
+            ++generation;
+        }
+        wake.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [&] { return pending == 0; });
+    }
+};
+
+// ================= Deadlines =================
+// A request's compute budget: the point in time after which long searches
+// give up and report what they have. The default one never passes.
+struct Deadline
+{
+    std::chrono::steady_clock::time_point at = std::chrono::steady_clock::time_point::max();
+
+    // ms milliseconds from now; no limit if ms <= 0
+    static Deadline in(int ms)
+    {
+        Deadline d;
+        if (ms > 0)
+            d.at = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        return d;
+    }
+
+    bool passed() const { return std::chrono::steady_clock::now() >= at; }
+};
+
+// Polls a Deadline from one search's inner loop. The clock is read only
+// every POLL_INTERVAL calls, and once the deadline has passed poll() stays
+// true so the search unwinds quickly.
+class DeadlineCheck
+{
+    static const unsigned POLL_INTERVAL = 1024;
+    const Deadline &deadline;
+    unsigned polls = 0;
+    bool passed = false;
+
+public:
+    explicit DeadlineCheck(const Deadline &deadline) : deadline(deadline) {}
+
+    bool poll()
+    {
+        if (!passed && ++polls % POLL_INTERVAL == 0)
+            passed = deadline.passed();
+        return passed;
+    }
+
+    bool timedOut() const { return passed; }
+};
+
 class Graph
 {
     int V;
+    // Edges are collected here by addEdge() and packed into CSR form by freeze()
+    std::vector<std::pair<int, int>> edgeList;
+    // CSR adjacency: the neighbors of v are targets[offsets[v] .. offsets[v + 1])
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edgeIds; // edgeIds[i] is the index in edgeList of half-edge i
+    std::vector<int> weights; // weights[id] is the weight of edgeList[id]
+    bool unitWeights = true;
+    bool sorted = false;
+    // Edge membership index built by freeze(): a bit matrix (row v starts at
+    // adjBits[v * rowWords]) up to MATRIX_MAX_V vertices, a hash of packed
+    // (u, v) keys above that
+    static const int MATRIX_MAX_V = 4096;
+    // Largest V solved by the Held-Karp bitmask DP (2^(V-1) words of memory)
+    static const int HELD_KARP_MAX_V = 24;
+    // isConnected() switches to the parallel BFS at this many vertices, and
+    // a top-down level wakes the other threads only above this many edges
+    static const int PARALLEL_BFS_MIN_V = 1 << 16;
+    static const int PARALLEL_LEVEL_MIN_EDGES = 1 << 14;
+    // Direction switching thresholds of the parallel BFS
+    static const int BFS_ALPHA = 14;
+    static const int BFS_BETA = 24;
+    // findMSTWeight() runs parallel Borůvka from this many edges
+    static const int PARALLEL_MST_MIN_EDGES = 1 << 18;
+    std::vector<uint64_t> adjBits;
+    size_t rowWords = 0;
+    std::vector<uint64_t> edgeKeys;
+    size_t keyMask = 0;
+
+    static uint64_t edgeKey(int u, int v)
+    {
+        return ((uint64_t)(uint32_t)u << 32) | (uint32_t)v;
+    }
+
+    static size_t keySlot(uint64_t key)
+    {
+        return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 17);
+    }
+
+    void buildEdgeIndex()
+    {
+        adjBits.clear();
+        edgeKeys.clear();
+        if (V <= MATRIX_MAX_V)
+        {
+            rowWords = ((size_t)V + 63) / 64;
+            adjBits.assign((size_t)V * rowWords, 0);
+            for (int u = 0; u < V; ++u)
+                for (int v : neighbors(u))
+                    adjBits[u * rowWords + (v >> 6)] |= 1ULL << (v & 63);
+            return;
+        }
+        size_t cap = 16;
+        while (cap < targets.size() * 2)
+            cap <<= 1;
+        keyMask = cap - 1;
+        edgeKeys.assign(cap, 0);
+        for (int u = 0; u < V; ++u)
+        {
+            for (int v : neighbors(u))
+            {
+                // Keys are stored +1 so that 0 marks an empty slot
+                uint64_t key = edgeKey(u, v) + 1;
+                size_t i = keySlot(key) & keyMask;
+                while (edgeKeys[i] != 0 && edgeKeys[i] != key)
+                    i = (i + 1) & keyMask;
+                edgeKeys[i] = key;
+            }
+        }
+    }
 
 public:
-    std::vector<std::vector<int>> adj;
+    struct NeighborRange
+    {
+        const int *first;
+        const int *last;
+        const int *begin() const { return first; }
+        const int *end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+    Graph(int V) : V(V), offsets(V + 1, 0) {}
+
+    // Largest V whose Hamiltonian circuit is found by Held-Karp
+    static int heldKarpMaxV() { return HELD_KARP_MAX_V; }
+
+    void addEdge(int u, int v, int w = 1)
+    {
+        edgeList.emplace_back(u, v);
+        weights.push_back(w);
+        unitWeights &= w == 1;
+    }
+
+    void reserveEdges(size_t count)
+    {
+        edgeList.reserve(count);
+        weights.reserve(count);
+    }
+
+    // Builds the frozen CSR arrays from the edge list. Call once after the
+    // last addEdge(); every algorithm below reads only the CSR arrays.
+    void freeze(bool sortNeighbors = true)
+    {
+        offsets.assign(V + 1, 0);
+        for (const auto &e : edgeList)
+        {
+            ++offsets[e.first + 1];
+            ++offsets[e.second + 1];
+        }
+        for (int i = 0; i < V; ++i)
+            offsets[i + 1] += offsets[i];
+
+        // Half-edges are packed as (target << 32 | edge id) so that sorting a
+        // vertex's neighbors carries the edge ids along
+        std::vector<uint64_t> packed(offsets[V]);
+        std::vector<int> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t id = 0; id < edgeList.size(); ++id)
+        {
+            const auto &e = edgeList[id];
+            packed[pos[e.first]++] = (uint64_t)e.second << 32 | id;
+            packed[pos[e.second]++] = (uint64_t)e.first << 32 | id;
+        }
+
+        sorted = sortNeighbors;
+        if (sorted)
+            for (int v = 0; v < V; ++v)
+                std::sort(packed.begin() + offsets[v], packed.begin() + offsets[v + 1]);
+
+        targets.resize(packed.size());
+        edgeIds.resize(packed.size());
+        for (size_t i = 0; i < packed.size(); ++i)
+        {
+            targets[i] = (int)(packed[i] >> 32);
+            edgeIds[i] = (int)(uint32_t)packed[i];
+        }
+        buildEdgeIndex();
+    }
+
+    NeighborRange neighbors(int v) const
+    {
+        return {targets.data() + offsets[v], targets.data() + offsets[v + 1]};
+    }
+
+    int degree(int v) const
+    {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    // O(1) edge test against the index built by freeze()
+    bool hasEdge(int u, int v) const
+    {
+        if (V <= MATRIX_MAX_V)
+            return (adjBits[u * rowWords + (v >> 6)] >> (v & 63)) & 1;
+        uint64_t key = edgeKey(u, v) + 1;
+        for (size_t i = keySlot(key) & keyMask; edgeKeys[i] != 0; i = (i + 1) & keyMask)
+            if (edgeKeys[i] == key)
+                return true;
+        return false;
+    }
+
+    // Bit row of v's neighbors, or nullptr when V is above MATRIX_MAX_V
+    const uint64_t *adjacencyRow(int v) const
+    {
+        return V <= MATRIX_MAX_V ? adjBits.data() + v * rowWords : nullptr;
+    }
+
+    // Approximate heap footprint, used as the graph's cost in the cache
+    size_t memoryBytes() const
+    {
+        return sizeof(*this) + edgeList.capacity() * sizeof(edgeList[0]) +
+               (offsets.capacity() + targets.capacity() + edgeIds.capacity() + weights.capacity()) * sizeof(int) +
+               (adjBits.capacity() + edgeKeys.capacity()) * sizeof(uint64_t);
+    }
+
+    // Reusable traversal buffers, one set per thread. Visited marks are epoch
+    // stamps, so begin() starts a fresh traversal without clearing V flags.
+    struct Traversal
+    {
+        std::vector<unsigned> mark;
+        unsigned epoch = 0;
+        std::vector<int> stack;
+
+        void begin(int V)
+        {
+            if (mark.size() < (size_t)V)
+            {
+                mark.assign(V, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0)
+            {
+                std::fill(mark.begin(), mark.end(), 0);
+                epoch = 1;
+            }
+        }
+        bool visited(int v) const { return mark[v] == epoch; }
+        void visit(int v) { mark[v] = epoch; }
+    };
+
+    static Traversal &traversal()
+    {
+        thread_local Traversal t;
+        return t;
+    }
+
+    // Iterative DFS from start over vertices not yet visited in the current
+    // epoch of t; calls visit(v) once for every vertex reached
+    template <typename Visit>
+    void dfs(int start, Traversal &t, Visit visit) const
+    {
+        t.stack.clear();
+        t.stack.push_back(start);
+        t.visit(start);
+        while (!t.stack.empty())
+        {
+            int v = t.stack.back();
+            t.stack.pop_back();
+            visit(v);
+            for (int u : neighbors(v))
+            {
+                if (!t.visited(u))
+                {
+                    t.visit(u);
+                    t.stack.push_back(u);
+                }
+            }
+        }
+    }
 
-    Graph(int V) : V(V), adj(V) {}
+    // Threads used by the parallel BFS and Borůvka passes on large graphs;
+    // 1 keeps every request on the serial code
+    static int &parallelThreads()
+    {
+        static int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+        return threads;
+    }
+
+    // The one team behind the parallel passes, built on first use with
+    // parallelThreads() members. Requests already run on a pool with a thread
+    // per core, so a pass only goes parallel if it can lease the team; one
+    // that finds it busy runs serially, and concurrent requests never start
+    // threads of their own.
+    struct SharedTeam
+    {
+        std::mutex lease;
+        ThreadTeam team{parallelThreads()};
+    };
+
+    static SharedTeam &sharedTeam()
+    {
+        static SharedTeam shared;
+        return shared;
+    }
+
+    // Direction-optimizing BFS (Beamer et al.) from start over atomic bitmaps;
+    // returns the number of vertices reached. Top-down levels expand a
+    // frontier list and claim neighbors with fetch_or. Once the frontier's
+    // edges exceed 1/BFS_ALPHA of the unexplored ones, levels run bottom-up:
+    // every unvisited vertex scans its neighbors for one in the frontier
+    // bitmap and stops at the first. It returns to top-down when the frontier
+    // shrinks below V/BFS_BETA vertices.
+    int parallelBfs(int start, ThreadTeam &team) const
+    {
+        size_t words = ((size_t)V + 63) / 64;
+        std::vector<std::atomic<uint64_t>> visited(words), frontier(words), next(words);
+        for (size_t w = 0; w < words; ++w)
+        {
+            visited[w].store(0, std::memory_order_relaxed);
+            frontier[w].store(0, std::memory_order_relaxed);
+            next[w].store(0, std::memory_order_relaxed);
+        }
+        auto bit = [](int v) { return 1ULL << (v & 63); };
+
+        // Per-member results of the current level
+        std::vector<std::vector<int>> found(team.size());
+        std::vector<int> foundCount(team.size());
+        std::vector<long long> foundEdges(team.size());
+        std::vector<int> queue{start};
+        visited[start >> 6].store(bit(start), std::memory_order_relaxed);
+
+        long long frontierEdges = degree(start);
+        long long unexploredEdges = (long long)targets.size() - frontierEdges;
+        int frontierSize = 1, reached = 1;
+        bool topDown = true;
+
+        // One top-down step over queue[first, last), newly claimed vertices
+        // go to found[id]
+        auto expandTopDown = [&](int id, size_t first, size_t last)
+        {
+            long long edges = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                for (int u : neighbors(queue[i]))
+                {
+                    std::atomic<uint64_t> &word = visited[u >> 6];
+                    if (word.load(std::memory_order_relaxed) & bit(u))
+                        continue;
+                    if (word.fetch_or(bit(u), std::memory_order_relaxed) & bit(u))
+                        continue;
+                    found[id].push_back(u);
+                    edges += degree(u);
+                }
+            }
+            foundCount[id] = (int)found[id].size();
+            foundEdges[id] = edges;
+        };
+
+        // One bottom-up step over bitmap words [first, last), which this
+        // member owns in visited and next
+        auto expandBottomUp = [&](int id, size_t first, size_t last)
+        {
+            int count = 0;
+            long long edges = 0;
+            for (size_t w = first; w < last; ++w)
+            {
+                size_t base = w * 64;
+                uint64_t unvisited = ~visited[w].load(std::memory_order_relaxed);
+                if (base + 64 > (size_t)V)
+                    unvisited &= (1ULL << (V - base)) - 1;
+                uint64_t claimed = 0;
+                for (uint64_t m = unvisited; m; m &= m - 1)
+                {
+                    int v = (int)(base + __builtin_ctzll(m));
+                    for (int u : neighbors(v))
+                    {
+                        if (frontier[u >> 6].load(std::memory_order_relaxed) & bit(u))
+                        {
+                            claimed |= bit(v);
+                            ++count;
+                            edges += degree(v);
+                            break;
+                        }
+                    }
+                }
+                if (claimed)
+                {
+                    visited[w].fetch_or(claimed, std::memory_order_relaxed);
+                    next[w].store(claimed, std::memory_order_relaxed);
+                }
+            }
+            foundCount[id] = count;
+            foundEdges[id] = edges;
+        };
+
+        auto level = [&](int id)
+        {
+            size_t total = topDown ? queue.size() : words;
+            size_t chunk = (total + team.size() - 1) / team.size();
+            size_t first = std::min(total, id * chunk), last = std::min(total, first + chunk);
+            if (topDown)
+                expandTopDown(id, first, last);
+            else
+                expandBottomUp(id, first, last);
+        };
+
+        while (frontierSize > 0)
+        {
+            bool wantTopDown = topDown ? frontierEdges * BFS_ALPHA <= unexploredEdges
+                                       : frontierSize * (long long)BFS_BETA < V;
+            if (wantTopDown != topDown)
+            {
+                // Hand the frontier over to the other representation
+                if (topDown)
+                {
+                    for (int v : queue)
+                        frontier[v >> 6].fetch_or(bit(v), std::memory_order_relaxed);
+                }
+                else
+                {
+                    queue.clear();
+                    for (size_t w = 0; w < words; ++w)
+                    {
+                        for (uint64_t m = frontier[w].exchange(0, std::memory_order_relaxed); m; m &= m - 1)
+                            queue.push_back((int)(w * 64 + __builtin_ctzll(m)));
+                    }
+                }
+                topDown = wantTopDown;
+            }
+
+            for (int id = 0; id < team.size(); ++id)
+            {
+                found[id].clear();
+                foundCount[id] = 0;
+                foundEdges[id] = 0;
+            }
+            // A small top-down level is not worth waking the team for
+            if (topDown && frontierEdges < PARALLEL_LEVEL_MIN_EDGES)
+                expandTopDown(0, 0, queue.size());
+            else
+                team.run(level);
+
+            frontierSize = 0;
+            frontierEdges = 0;
+            for (int id = 0; id < team.size(); ++id)
+            {
+                frontierSize += foundCount[id];
+                frontierEdges += foundEdges[id];
+            }
+            if (topDown)
+            {
+                queue.clear();
+                for (const auto &part : found)
+                    queue.insert(queue.end(), part.begin(), part.end());
+            }
+            else
+            {
+                frontier.swap(next);
+                for (auto &w : next)
+                    w.store(0, std::memory_order_relaxed);
+            }
+            reached += frontierSize;
+            unexploredEdges -= frontierEdges;
+        }
+        return reached;
+    }
+
+    bool isConnected()
+    {
+        int start = -1;
+        for (int i = 0; i < V; ++i)
+        {
+            if (degree(i) > 0)
+            {
+                start = i;
+                break;
+            }
+        }
+        if (start == -1)
+            return true;
+        if (V >= PARALLEL_BFS_MIN_V && parallelThreads() > 1)
+        {
+            SharedTeam &shared = sharedTeam();
+            std::unique_lock<std::mutex> lease(shared.lease, std::try_to_lock);
+            if (lease.owns_lock())
+            {
+                int withEdges = 0;
+                for (int i = 0; i < V; ++i)
+                    withEdges += degree(i) > 0;
+                return parallelBfs(start, shared.team) == withEdges;
+            }
+        }
+        Traversal &t = traversal();
+        t.begin(V);
+        dfs(start, t, [](int) {});
+        for (int i = 0; i < V; ++i)
+            if (!t.visited(i) && degree(i) > 0)
+                return false;
+        return true;
+    }
+
+    bool isEulerianCircuitPossible()
+    {
+        for (int i = 0; i < V; ++i)
+            if (degree(i) % 2 != 0)
+                return false;
+        return isConnected();
+    }
 
-    void addEdge(int u, int v)
+    std::vector<int> findEulerianCircuit()
+    {
+        std::vector<int> circuit;
+        if (V == 0 || !isEulerianCircuitPossible())
+            return circuit;
+        // Hierholzer over edge ids: each vertex keeps a cursor into its CSR
+        // range and skips edges already walked from the other endpoint, so the
+        // whole circuit is one O(V + E) pass without copying the graph
+        std::vector<bool> used(edgeList.size(), false);
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        std::vector<int> currPath;
+        std::vector<int> circuitResult;
+        circuitResult.reserve(edgeList.size() + 1);
+        int start = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            if (degree(v) > 0)
+            {
+                start = v;
+                break;
+            }
+        }
+        currPath.push_back(start);
+        while (!currPath.empty())
+        {
+            int v = currPath.back();
+            int &i = cursor[v];
+            while (i < offsets[v + 1] && used[edgeIds[i]])
+                ++i;
+            if (i < offsets[v + 1])
+            {
+                used[edgeIds[i]] = true;
+                currPath.push_back(targets[i++]);
+            }
+            else
+            {
+                circuitResult.push_back(v);
+                currPath.pop_back();
+            }
+        }
+        std::reverse(circuitResult.begin(), circuitResult.end());
+        return circuitResult;
+    }
+    // Formatters below write a result into out, as text or (binary) in the
+    // packed form described in framing.hpp
+    void eulerianCircuit(ResponseBuffer &out, bool binary = false)
     {
-        adj[u].push_back(v);
-        adj[v].push_back(u);
+        auto circuit = findEulerianCircuit();
+        if (binary)
+        {
+            putSequence(out, circuit);
+            return;
+        }
+        if (circuit.empty())
+        {
+            out << "No Eulerian Circuit";
+            return;
+        }
+        out << "Eulerian Circuit: ";
+        for (int v : circuit)
+            out << v << ' ';
     }
 
-    bool isConnected()
+    // Sort-based Kruskal: edges packed as (weight << 32 | edge id) so one
+    // integer sort orders them by weight
+    long long kruskalMST() const
+    {
+        std::vector<uint64_t> order(edgeList.size());
+        for (size_t id = 0; id < edgeList.size(); ++id)
+            order[id] = (uint64_t)weights[id] << 32 | id;
+        std::sort(order.begin(), order.end());
+
+        DisjointSets sets(V);
+        long long total = 0;
+        int joined = 0;
+        for (uint64_t key : order)
+        {
+            const auto &e = edgeList[(uint32_t)key];
+            if (sets.unite(e.first, e.second))
+            {
+                total += (long long)(key >> 32);
+                if (++joined == V - 1)
+                    break;
+            }
+        }
+        return total;
+    }
+
+    // Heap-based Prim, restarted from every vertex not yet in the forest.
+    // Stale heap entries are skipped instead of decreasing keys.
+    long long primMST() const
+    {
+        std::vector<char> inTree(V, 0);
+        std::vector<int> best(V, INT_MAX);
+        using Entry = std::pair<int, int>; // weight, vertex
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        long long total = 0;
+        for (int s = 0; s < V; ++s)
+        {
+            if (inTree[s])
+                continue;
+            best[s] = 0;
+            heap.push({0, s});
+            while (!heap.empty())
+            {
+                Entry top = heap.top();
+                heap.pop();
+                int v = top.second;
+                if (inTree[v] || top.first > best[v])
+                    continue;
+                inTree[v] = 1;
+                total += top.first;
+                for (int i = offsets[v]; i < offsets[v + 1]; ++i)
+                {
+                    int u = targets[i], w = weights[edgeIds[i]];
+                    if (!inTree[u] && w < best[u])
+                    {
+                        best[u] = w;
+                        heap.push({w, u});
+                    }
+                }
+            }
+        }
+        return total;
+    }
+
+    // Parallel Borůvka: each round the team scans the edges in chunks and
+    // keeps, per component, the cheapest leaving edge as an atomic minimum of
+    // (weight << 32 | edge id); the edge id breaks ties, so the chosen edges
+    // never form a cycle. The merges then run serially. Every round at least
+    // halves the number of components.
+    long long boruvkaMST(ThreadTeam &team) const
+    {
+        const uint64_t NONE = UINT64_MAX;
+        DisjointSets sets(V);
+        std::vector<int> comp(V);
+        std::vector<std::atomic<uint64_t>> cheapest(V);
+
+        auto scan = [&](int id)
+        {
+            size_t chunk = (edgeList.size() + team.size() - 1) / team.size();
+            size_t first = std::min(edgeList.size(), id * chunk);
+            size_t last = std::min(edgeList.size(), first + chunk);
+            for (size_t e = first; e < last; ++e)
+            {
+                int a = comp[edgeList[e].first], b = comp[edgeList[e].second];
+                if (a == b)
+                    continue;
+                uint64_t key = (uint64_t)weights[e] << 32 | e;
+                for (int c : {a, b})
+                {
+                    uint64_t cur = cheapest[c].load(std::memory_order_relaxed);
+                    while (key < cur && !cheapest[c].compare_exchange_weak(cur, key, std::memory_order_relaxed))
+                        ;
+                }
+            }
+        };
+
+        long long total = 0;
+        bool merged = true;
+        while (merged)
+        {
+            for (int v = 0; v < V; ++v)
+            {
+                comp[v] = sets.find(v);
+                cheapest[v].store(NONE, std::memory_order_relaxed);
+            }
+            team.run(scan);
+
+            merged = false;
+            for (int v = 0; v < V; ++v)
+            {
+                uint64_t key = cheapest[v].load(std::memory_order_relaxed);
+                if (key == NONE)
+                    continue;
+                const auto &e = edgeList[(uint32_t)key];
+                if (sets.unite(e.first, e.second))
+                {
+                    total += (long long)(key >> 32);
+                    merged = true;
+                }
+            }
+        }
+        return total;
+    }
+
+    // Minimum spanning forest weight. With unit weights every spanning forest
+    // is minimal, so the answer is V minus the number of components and no
+    // edge is sorted. Otherwise large graphs run parallel Borůvka, dense ones
+    // (a quarter or more of all vertex pairs) Prim and the rest Kruskal.
+    long long findMSTWeight()
+    {
+        if (unitWeights)
+        {
+            int count;
+            componentLabels(count);
+            return V - count;
+        }
+        if (edgeList.size() >= (size_t)PARALLEL_MST_MIN_EDGES && parallelThreads() > 1)
+        {
+            SharedTeam &shared = sharedTeam();
+            std::unique_lock<std::mutex> lease(shared.lease, std::try_to_lock);
+            if (lease.owns_lock())
+                return boruvkaMST(shared.team);
+        }
+        if (4 * (long long)edgeList.size() >= (long long)V * (V - 1) / 2)
+            return primMST();
+        return kruskalMST();
+    }
+    void MST(ResponseBuffer &out, bool binary = false)
+    {
+        if (binary)
+            putFixed64(out, findMSTWeight());
+        else
+            out << "MST weight: " << findMSTWeight();
+    }
+
+    // Vertices in degeneracy order (repeatedly remove a minimum-degree vertex),
+    // bucket-queue version of Batagelj-Zaversnik, O(V + E)
+    std::vector<int> degeneracyOrder() const
+    {
+        std::vector<int> deg(V), pos(V), vert(V);
+        int maxDeg = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            deg[v] = degree(v);
+            maxDeg = std::max(maxDeg, deg[v]);
+        }
+        std::vector<int> bin(maxDeg + 1, 0);
+        for (int v = 0; v < V; ++v)
+            ++bin[deg[v]];
+        for (int d = 0, start = 0; d <= maxDeg; ++d)
+        {
+            int num = bin[d];
+            bin[d] = start;
+            start += num;
+        }
+        for (int v = 0; v < V; ++v)
+        {
+            pos[v] = bin[deg[v]]++;
+            vert[pos[v]] = v;
+        }
+        for (int d = maxDeg; d > 0; --d)
+            bin[d] = bin[d - 1];
+        bin[0] = 0;
+
+        for (int i = 0; i < V; ++i)
+        {
+            int v = vert[i];
+            for (int u : neighbors(v))
+            {
+                if (deg[u] > deg[v])
+                {
+                    int du = deg[u], pu = pos[u], pw = bin[du], w = vert[pw];
+                    if (u != w)
+                    {
+                        pos[u] = pw;
+                        vert[pu] = w;
+                        pos[w] = pu;
+                        vert[pw] = u;
+                    }
+                    ++bin[du];
+                    --deg[u];
+                }
+            }
+        }
+        return vert;
+    }
+
+    // Bron-Kerbosch search inside one vertex's neighborhood. The k local
+    // vertices are renumbered 0..k-1 and every candidate set is a bitset of
+    // `words` words; each recursion level owns a slice of `sets`.
+    struct CliqueSearch
+    {
+        DeadlineCheck check;
+        size_t words = 0;
+        std::vector<uint64_t> rows; // local adjacency, row i at rows[i * words]
+        std::vector<uint64_t> sets;
+
+        explicit CliqueSearch(const Deadline &deadline) : check(deadline) {}
+
+        void reset(const Graph &g, const std::vector<int> &local, int setsPerLevel)
+        {
+            size_t k = local.size();
+            words = (k + 63) / 64;
+            rows.assign(k * words, 0);
+            for (size_t i = 0; i < k; ++i)
+                for (size_t j = i + 1; j < k; ++j)
+                    if (g.hasEdge(local[i], local[j]))
+                    {
+                        rows[i * words + (j >> 6)] |= 1ULL << (j & 63);
+                        rows[j * words + (i >> 6)] |= 1ULL << (i & 63);
+                    }
+            sets.assign((k + 2) * setsPerLevel * words, 0);
+        }
+
+        const uint64_t *row(size_t v) const { return rows.data() + v * words; }
+
+        // Every clique inside P (P is consumed; the child level follows it).
+        // Past the deadline it returns the cliques counted so far.
+        long long countAll(uint64_t *P)
+        {
+            long long total = 0;
+            uint64_t *child = P + words;
+            for (size_t w = 0; w < words; ++w)
+            {
+                while (P[w])
+                {
+                    if (check.poll())
+                        return total;
+                    size_t v = w * 64 + __builtin_ctzll(P[w]);
+                    P[w] &= P[w] - 1;
+                    ++total;
+                    const uint64_t *nv = row(v);
+                    bool any = false;
+                    for (size_t i = 0; i < words; ++i)
+                        any |= (child[i] = P[i] & nv[i]) != 0;
+                    if (any)
+                        total += countAll(child);
+                }
+            }
+            return total;
+        }
+
+        // Maximal cliques extending R with candidates P and excluded X, with
+        // Tomita pivoting. Level layout is P, X, then the branching set.
+        long long countMaximal(uint64_t *P)
+        {
+            if (check.poll())
+                return 0;
+            uint64_t *X = P + words, *branch = X + words, *child = branch + words;
+            bool pEmpty = true, xEmpty = true;
+            for (size_t i = 0; i < words; ++i)
+            {
+                pEmpty &= P[i] == 0;
+                xEmpty &= X[i] == 0;
+            }
+            if (pEmpty)
+                return xEmpty ? 1 : 0;
+
+            // Pivot: the vertex of P | X with the most neighbors in P
+            size_t pivot = 0;
+            int best = -1;
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t m = P[w] | X[w]; m; m &= m - 1)
+                {
+                    size_t u = w * 64 + __builtin_ctzll(m);
+                    const uint64_t *nu = row(u);
+                    int common = 0;
+                    for (size_t i = 0; i < words; ++i)
+                        common += __builtin_popcountll(P[i] & nu[i]);
+                    if (common > best)
+                    {
+                        best = common;
+                        pivot = u;
+                    }
+                }
+            }
+
+            const uint64_t *np = row(pivot);
+            for (size_t i = 0; i < words; ++i)
+                branch[i] = P[i] & ~np[i];
+
+            long long total = 0;
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t m = branch[w]; m; m &= m - 1)
+                {
+                    size_t v = w * 64 + __builtin_ctzll(m);
+                    const uint64_t *nv = row(v);
+                    for (size_t i = 0; i < words; ++i)
+                    {
+                        child[i] = P[i] & nv[i];
+                        child[words + i] = X[i] & nv[i];
+                    }
+                    total += countMaximal(child);
+                    P[w] &= ~(1ULL << (v & 63));
+                    X[w] |= 1ULL << (v & 63);
+                }
+            }
+            return total;
+        }
+    };
+
+    // Counts all non-empty cliques, or only the maximal ones. Each vertex v is
+    // the earliest member (in degeneracy order) of the cliques it roots, so
+    // the search only ever sees v's later neighbors as candidates and stays
+    // within the graph's degeneracy even when V is in the thousands.
+    // complete is false if the deadline cut the count short (a lower bound).
+    long long countCliques(const Deadline &deadline, bool &complete, bool maximalOnly = false)
+    {
+        std::vector<int> order = degeneracyOrder();
+        std::vector<int> rank(V);
+        for (int i = 0; i < V; ++i)
+            rank[order[i]] = i;
+
+        CliqueSearch search(deadline);
+        std::vector<int> local;
+        long long count = 0;
+        for (int v : order)
+        {
+            if (search.check.timedOut())
+                break;
+            local.clear();
+            for (int u : neighbors(v))
+                if (rank[u] > rank[v])
+                    local.push_back(u);
+            size_t later = local.size();
+
+            if (!maximalOnly)
+            {
+                search.reset(*this, local, 1);
+                for (size_t i = 0; i < later; ++i)
+                    search.sets[i >> 6] |= 1ULL << (i & 63);
+                count += 1 + search.countAll(search.sets.data());
+                continue;
+            }
+
+            for (int u : neighbors(v))
+                if (rank[u] < rank[v])
+                    local.push_back(u);
+            search.reset(*this, local, 3);
+            uint64_t *P = search.sets.data(), *X = P + search.words;
+            for (size_t i = 0; i < local.size(); ++i)
+                (i < later ? P : X)[i >> 6] |= 1ULL << (i & 63);
+            count += search.countMaximal(P);
+        }
+        complete = !search.check.timedOut();
+        return count;
+    }
+    void numCliques(ResponseBuffer &out, bool binary, const Deadline &deadline, bool &complete)
+    {
+        long long count = countCliques(deadline, complete);
+        if (binary)
+            putFixed64(out, count);
+        else if (complete)
+            out << "Number of Cliques: " << count;
+        else
+            out << "Number of Cliques: at least " << count << " (timed out)";
+    }
+    // Union-find with union by rank and path halving
+    struct DisjointSets
+    {
+        std::vector<int> parent;
+        std::vector<unsigned char> rank;
+
+        explicit DisjointSets(int n) : parent(n), rank(n, 0)
+        {
+            for (int i = 0; i < n; ++i)
+                parent[i] = i;
+        }
+
+        int find(int x)
+        {
+            while (parent[x] != x)
+                x = parent[x] = parent[parent[x]];
+            return x;
+        }
+
+        // Returns false if a and b were already in the same set
+        bool unite(int a, int b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return false;
+            if (rank[a] < rank[b])
+                std::swap(a, b);
+            parent[b] = a;
+            if (rank[a] == rank[b])
+                ++rank[a];
+            return true;
+        }
+    };
+
+    // addEdge() stores every edge in both directions, so the strongly
+    // connected components are the connected components: one union-find pass
+    // over the edge list, no transpose and no DFS. Returns each vertex's
+    // component, numbered in order of the component's smallest vertex; count
+    // receives the number of components.
+    std::vector<int> componentLabels(int &count) const
+    {
+        DisjointSets sets(V);
+        for (const auto &e : edgeList)
+            sets.unite(e.first, e.second);
+
+        std::vector<int> label(V), rootLabel(V, -1);
+        count = 0;
+        for (int v = 0; v < V; ++v)
+        {
+            int root = sets.find(v);
+            if (rootLabel[root] < 0)
+                rootLabel[root] = count++;
+            label[v] = rootLabel[root];
+        }
+        return label;
+    }
+
+    std::vector<std::vector<int>> findSCCGroups()
+    {
+        int count;
+        std::vector<int> label = componentLabels(count);
+        std::vector<std::vector<int>> sccGroups(count);
+        for (int v = 0; v < V; ++v)
+            sccGroups[label[v]].push_back(v);
+        return sccGroups;
+    }
+
+    void SCC(ResponseBuffer &out, bool binary = false)
+    {
+        if (binary)
+        {
+            int count;
+            std::vector<int> label = componentLabels(count);
+            putLabels(out, label, count);
+            return;
+        }
+        auto groups = findSCCGroups();
+        if (groups.empty())
+        {
+            out << "No Strongly Connected Components found.";
+            return;
+        }
+
+        out << "Strongly Connected Components:";
+        for (size_t i = 0; i < groups.size(); ++i)
+        {
+            out << "\nComponent " << i + 1 << ": ";
+            for (int v : groups[i])
+            {
+                out << v << ' ';
+            }
+        }
+    }
+
+    // A Hamiltonian circuit needs a biconnected graph: one DFS from vertex 0
+    // (iterative, with low-links) rejects disconnected graphs and graphs with
+    // an articulation point (which also covers bridges when V >= 3)
+    bool isBiconnected()
+    {
+        std::vector<int> disc(V, -1), low(V), parent(V, -1), cursor(V, 0);
+        std::vector<int> stack;
+        int index = 0, rootChildren = 0;
+        disc[0] = low[0] = index++;
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            int v = stack.back();
+            if (cursor[v] < degree(v))
+            {
+                int u = neighbors(v).first[cursor[v]++];
+                if (disc[u] == -1)
+                {
+                    parent[u] = v;
+                    disc[u] = low[u] = index++;
+                    stack.push_back(u);
+                    if (v == 0)
+                        ++rootChildren;
+                }
+                else if (u != parent[v])
+                    low[v] = std::min(low[v], disc[u]);
+                continue;
+            }
+            stack.pop_back();
+            if (stack.empty())
+                break;
+            int p = stack.back();
+            low[p] = std::min(low[p], low[v]);
+            if (p != 0 && low[v] >= disc[p])
+                return false;
+        }
+        return index == V && rootChildren <= 1;
+    }
+
+    // Held-Karp over subsets of vertices 1..V-1 (bit i stands for vertex i + 1):
+    // reach[mask] holds every end vertex of a path that leaves 0 and visits
+    // exactly mask. O(2^V * V) time, 2^(V-1) words of memory.
+    std::vector<int> heldKarpCircuit(DeadlineCheck &check)
+    {
+        int n = V - 1;
+        uint32_t full = (1u << n) - 1;
+        std::vector<uint32_t> adjMask(V);
+        for (int v = 0; v < V; ++v)
+            adjMask[v] = (uint32_t)(adjacencyRow(v)[0] >> 1) & full;
+
+        std::vector<uint32_t> reach(full + 1, 0);
+        for (uint32_t mask = 1; mask <= full; ++mask)
+        {
+            if (check.poll())
+                return {};
+            if ((mask & (mask - 1)) == 0)
+            {
+                reach[mask] = mask & adjMask[0];
+                continue;
+            }
+            uint32_t ends = 0;
+            for (uint32_t m = mask; m; m &= m - 1)
+            {
+                int i = __builtin_ctz(m);
+                if (reach[mask ^ (1u << i)] & adjMask[i + 1])
+                    ends |= 1u << i;
+            }
+            reach[mask] = ends;
+        }
+
+        std::vector<int> path;
+        uint32_t ends = reach[full] & adjMask[0];
+        if (ends == 0)
+            return path;
+        // Walk back from an end adjacent to 0, peeling one vertex at a time
+        int cur = __builtin_ctz(ends);
+        for (uint32_t mask = full; mask; )
+        {
+            path.push_back(cur + 1);
+            mask ^= 1u << cur;
+            if (mask)
+                cur = __builtin_ctz(reach[mask] & adjMask[cur + 1]);
+        }
+        path.push_back(0);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Search state for the backtracking engine used above HELD_KARP_MAX_V
+    struct HamiltonSearch
+    {
+        DeadlineCheck check;
+        std::vector<int> path;
+        std::vector<char> visited;
+        std::vector<int> freeDeg; // unvisited neighbors of each vertex
+        std::vector<int> queue;
+        std::vector<int> seen;
+        int stamp = 0;
+
+        explicit HamiltonSearch(const Deadline &deadline) : check(deadline) {}
+    };
+
+    // Every unvisited vertex must stay reachable from the path's end through
+    // unvisited vertices, or the path can never be completed
+    bool remainderConnected(HamiltonSearch &s, int end, int remaining)
+    {
+        ++s.stamp;
+        s.queue.clear();
+        s.queue.push_back(end);
+        s.seen[end] = s.stamp;
+        int reached = 0;
+        for (size_t head = 0; head < s.queue.size(); ++head)
+        {
+            for (int u : neighbors(s.queue[head]))
+            {
+                if (!s.visited[u] && s.seen[u] != s.stamp)
+                {
+                    s.seen[u] = s.stamp;
+                    s.queue.push_back(u);
+                    ++reached;
+                }
+            }
+        }
+        return reached == remaining;
+    }
+
+    // Extends path[0..pos) one vertex at a time, trying the candidates with
+    // the fewest unvisited neighbors first (Warnsdorff's rule); gives up
+    // once the deadline passes
+    bool hamiltonUtil(int pos, HamiltonSearch &s)
+    {
+        if (s.check.poll())
+            return false;
+        int end = s.path[pos - 1];
+        if (pos == V)
+            return hasEdge(end, s.path[0]);
+
+        std::vector<int> candidates;
+        for (int v : neighbors(end))
+            if (!s.visited[v])
+                candidates.push_back(v);
+        std::sort(candidates.begin(), candidates.end(), [&](int a, int b)
+                  { return s.freeDeg[a] < s.freeDeg[b]; });
+
+        for (int v : candidates)
+        {
+            s.path[pos] = v;
+            s.visited[v] = true;
+            for (int u : neighbors(v))
+                --s.freeDeg[u];
+
+            // 0 must keep an unvisited neighbor to close the circuit through
+            bool feasible = pos + 1 == V || s.freeDeg[s.path[0]] > 0;
+            if (feasible && end != s.path[0])
+            {
+                // end becomes interior: its unvisited neighbors lose it, and each
+                // still needs two usable neighbors (unvisited, the new end v, or 0
+                // to close the circuit)
+                for (int w : neighbors(end))
+                {
+                    if (!s.visited[w] && s.freeDeg[w] + hasEdge(w, v) + hasEdge(w, s.path[0]) < 2)
+                    {
+                        feasible = false;
+                        break;
+                    }
+                }
+            }
+            if (feasible && pos + 1 < V)
+                feasible = remainderConnected(s, v, V - pos - 1);
+            if (feasible && hamiltonUtil(pos + 1, s))
+                return true;
+
+            for (int u : neighbors(v))
+                ++s.freeDeg[u];
+            s.visited[v] = false;
+        }
+        return false;
+    }
+
+    // Hamiltonian circuit as V vertices starting at 0 (the edge back to 0 is
+    // implied), or an empty vector when there is none. Cheap necessary
+    // conditions run first, then Held-Karp for small V, then backtracking.
+    // complete is false if the deadline ended the search without an answer.
+    std::vector<int> findHamiltonianCircuit(const Deadline &deadline, bool &complete)
+    {
+        std::vector<int> none;
+        complete = true;
+        if (V < 3)
+            return none;
+        for (int v = 0; v < V; ++v)
+            if (degree(v) < 2)
+                return none;
+        if (!isBiconnected())
+            return none;
+        if (V <= HELD_KARP_MAX_V)
+        {
+            DeadlineCheck check(deadline);
+            std::vector<int> path = heldKarpCircuit(check);
+            complete = !check.timedOut();
+            return path;
+        }
+
+        HamiltonSearch s(deadline);
+        s.path.assign(V, -1);
+        s.visited.assign(V, false);
+        s.freeDeg.resize(V);
+        s.seen.assign(V, 0);
+        for (int v = 0; v < V; ++v)
+            s.freeDeg[v] = degree(v);
+        s.path[0] = 0;
+        s.visited[0] = true;
+        for (int u : neighbors(0))
+            --s.freeDeg[u];
+        if (hamiltonUtil(1, s))
+            return s.path;
+        complete = !s.check.timedOut();
+        return none;
+    }
+
+    void hamiltonianCircuit(ResponseBuffer &out, bool binary, const Deadline &deadline, bool &complete)
+    {
+        std::vector<int> path = findHamiltonianCircuit(deadline, complete);
+        if (binary)
+            putSequence(out, path);
+        else if (!complete)
+            out << "Hamiltonian Circuit search timed out";
+        else if (!path.empty())
+        {
+            out << "Hamiltonian Circuit: ";
+            for (int v : path)
+                out << v << " -> ";
+            out << path[0];
+        }
+        else
+        {
+            out << "Graph does not have a Hamiltonian Circuit";
+        }
+    }
+};
+
+// ================= Random Graph Generator =================
+// Builds a simple undirected graph with exactly E distinct edges, reproducible
+// for a given seed. Vertex pairs u < v are numbered k = v * (v - 1) / 2 + u and
+// E of those indices are drawn without replacement (Floyd's algorithm), so no
+// draw is ever rejected. Above 50% density the missing pairs are drawn instead
+// and every other pair is emitted in one sweep.
+class GraphGenerator
+{
+    // Open-addressing set of pair indices, sized once for the whole sample
+    class IndexSet
+    {
+        std::vector<long long> slots;
+        size_t mask;
+
+    public:
+        explicit IndexSet(size_t expected)
+        {
+            size_t cap = 16;
+            while (cap < expected * 2)
+                cap <<= 1;
+            slots.assign(cap, -1);
+            mask = cap - 1;
+        }
+
+        // Returns false if k was already present
+        bool insert(long long k)
+        {
+            size_t i = (size_t)(k * 0x9E3779B97F4A7C15ULL) & mask;
+            while (slots[i] != -1)
+            {
+                if (slots[i] == k)
+                    return false;
+                i = (i + 1) & mask;
+            }
+            slots[i] = k;
+            return true;
+        }
+    };
+
+    static std::vector<long long> sampleIndices(long long total, long long count, std::mt19937 &rng)
     {
-        std::vector<bool> visited(V, false);
-        int start = -1;
-        for (int i = 0; i < V; ++i)
+        std::vector<long long> picked;
+        picked.reserve(count);
+        IndexSet seen(count);
+        for (long long j = total - count; j < total; ++j)
         {
-            if (!adj[i].empty())
+            long long t = std::uniform_int_distribution<long long>(0, j)(rng);
+            if (!seen.insert(t))
             {
-                start = i;
-                break;
+                t = j;
+                seen.insert(t);
             }
+            picked.push_back(t);
         }
-        if (start == -1)
-            return true;
-        dfs(start, visited);
-        for (int i = 0; i < V; ++i)
-            if (!visited[i] && !adj[i].empty())
-                return false;
-        return true;
+        return picked;
     }
 
-    void dfs(int v, std::vector<bool> &visited)
+    static std::pair<int, int> decodePair(long long k)
     {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                dfs(u, visited);
+        long long v = (long long)((1.0 + std::sqrt(1.0 + 8.0 * (double)k)) / 2.0);
+        while (v * (v - 1) / 2 > k)
+            --v;
+        while ((v + 1) * v / 2 <= k)
+            ++v;
+        return {(int)(k - v * (v - 1) / 2), (int)v};
     }
 
-    bool isEulerianCircuitPossible()
+public:
+    static long long maxEdges(int V)
     {
-        for (int i = 0; i < V; ++i)
-            if (adj[i].size() % 2 != 0)
-                return false;
-        return isConnected();
+        return V > 1 ? (long long)V * (V - 1) / 2 : 0;
     }
 
-    std::vector<int> findEulerianCircuit()
+    // Weights are drawn uniformly from [1, maxWeight] after the edge set is
+    // sampled, so the same seed gives the same edges for any maxWeight
+    static Graph generate(int V, int E, int seed, int maxWeight = 1)
     {
-        std::vector<int> circuit;
-        if (!isEulerianCircuitPossible())
-            return circuit;
-        std::vector<std::vector<int>> tempAdj = adj;
-        std::stack<int> currPath;
-        std::vector<int> circuitResult;
-        currPath.push(0);
-        while (!currPath.empty())
+        Graph g(std::max(V, 0));
+        long long total = maxEdges(V);
+        long long edges = std::min<long long>(std::max(E, 0), total);
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> weightDist(1, std::max(maxWeight, 1));
+        auto weight = [&]
+        { return maxWeight > 1 ? weightDist(rng) : 1; };
+
+        g.reserveEdges(edges);
+        if (edges <= total / 2)
         {
-            int v = currPath.top();
-            if (!tempAdj[v].empty())
+            for (long long k : sampleIndices(total, edges, rng))
             {
-                int u = tempAdj[v].back();
-                tempAdj[v].pop_back();
-                auto &revList = tempAdj[u];
-                revList.erase(std::find(revList.begin(), revList.end(), v));
-                currPath.push(u);
+                auto edge = decodePair(k);
+                g.addEdge(edge.first, edge.second, weight());
             }
-            else
+        }
+        else
+        {
+            std::vector<long long> missing = sampleIndices(total, total - edges, rng);
+            std::sort(missing.begin(), missing.end());
+            size_t next = 0;
+            long long k = 0;
+            for (int v = 1; v < V; ++v)
             {
-                circuitResult.push_back(v);
-                currPath.pop();
+                for (int u = 0; u < v; ++u, ++k)
+                {
+                    if (next < missing.size() && missing[next] == k)
+                        ++next;
+                    else
+                        g.addEdge(u, v, weight());
+                }
             }
         }
-        std::reverse(circuitResult.begin(), circuitResult.end());
-        return circuitResult;
+        g.freeze();
+        return g;
+    }
+};
+
+// ================= Metrics =================
+// Stages timed for OP_STATS, per request unless noted: accepting a
+// connection, reading a readable socket, waiting in the compute queue,
+// generating a graph, each algorithm (in Algorithm order; the formatters
+// write straight into the response, so this includes formatting and caching
+// the result), joining the parts of a response, and one flush of a socket's
+// responses.
+enum Stage
+{
+    STAGE_ACCEPT,
+    STAGE_READ,
+    STAGE_QUEUE,
+    STAGE_GENERATE,
+    STAGE_EULER,
+    STAGE_SERIALIZE = STAGE_EULER + 5,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+Metrics metrics({"accept", "read", "compute_queue", "generate", "euler", "mst", "cliques", "scc", "hamilton",
+                 "serialize", "write"});
+
+// ================= Caches =================
+// Generation is deterministic in (V, E, seed, maxWeight), so repeated
+// requests share one generated graph and reuse each algorithm's formatted
+// result; text and binary results are cached apart.
+enum Algorithm { ALGO_EULER, ALGO_MST, ALGO_CLIQUES, ALGO_SCC, ALGO_HAMILTON, ALGO_COUNT };
+static_assert((int)ALGO_COUNT == RESULT_COUNT && (int)ALGO_HAMILTON == RESULT_HAMILTON, "binary results follow Algorithm order");
+using GraphKey = std::array<int, 4>;  // V, E, seed, maxWeight
+using ResultKey = std::array<int, 6>; // V, E, seed, maxWeight, algorithm, binary
+const size_t GRAPH_CACHE_BYTES = 256u << 20;
+const size_t RESULT_CACHE_BYTES = 64u << 20;
+LruCache<GraphKey, Graph, IntsHash<4>> graphCache(GRAPH_CACHE_BYTES);
+LruCache<ResultKey, const ResponseBuffer, IntsHash<6>> resultCache(RESULT_CACHE_BYTES);
+
+// The graph for key, generated on a cache miss
+std::shared_ptr<Graph> cachedGraph(const GraphKey &key)
+{
+    std::shared_ptr<Graph> g = graphCache.get(key);
+    if (!g)
+    {
+        {
+            StageTimer timer(metrics, STAGE_GENERATE);
+            g = std::make_shared<Graph>(GraphGenerator::generate(key[0], key[1], key[2], key[3]));
+        }
+        graphCache.put(key, g, g->memoryBytes());
+    }
+    return g;
+}
+
+// Appends the cached result for key to out; false on a miss
+bool cachedResult(const ResultKey &key, ResponseBuffer &out)
+{
+    std::shared_ptr<const ResponseBuffer> hit = resultCache.get(key);
+    if (hit)
+        out.append(hit);
+    return hit != nullptr;
+}
+
+// Formats the result for key from g into out and caches it, unless the
+// deadline cut it short; false in that case
+bool computeResult(Graph &g, const ResultKey &key, ResponseBuffer &out, const Deadline &deadline)
+{
+    bool binary = key[5];
+    bool complete = true;
+    StageTimer timer(metrics, STAGE_EULER + key[4]);
+    switch (key[4])
+    {
+    case ALGO_EULER:
+        g.eulerianCircuit(out, binary);
+        break;
+    case ALGO_MST:
+        g.MST(out, binary);
+        break;
+    case ALGO_CLIQUES:
+        g.numCliques(out, binary, deadline, complete);
+        break;
+    case ALGO_SCC:
+        g.SCC(out, binary);
+        break;
+    case ALGO_HAMILTON:
+        g.hamiltonianCircuit(out, binary, deadline, complete);
+        break;
     }
-    std::string eulerianCircuit()
+    // The cache keeps the formatted chunks themselves and out goes on to
+    // reference them, so nothing is copied unless the result is short
+    if (complete && resultCache.admits(out.size()))
     {
-        auto circuit = findEulerianCircuit();
-        if (circuit.empty())
-            return "No Eulerian Circuit";
-        std::string result = "Eulerian Circuit: ";
-        for (int v : circuit)
-            result += std::to_string(v) + " ";
-        return result;
+        std::shared_ptr<const ResponseBuffer> shared = ResponseBuffer::share(std::move(out));
+        resultCache.put(key, shared, shared->memoryBytes());
+        out.append(shared);
     }
+    return complete;
+}
+
+void printCacheStats()
+{
+    std::cout << "Cache hits/misses: graphs " << graphCache.hits() << "/" << graphCache.misses()
+              << ", results " << resultCache.hits() << "/" << resultCache.misses() << "\n";
+}
 
-    int findMSTWeight()
+// ================= Bounded MPMC Ring =================
+// Vyukov's bounded multi-producer/multi-consumer queue. Each cell carries a
+// sequence number saying whose turn it is: a producer may fill the cell for
+// position pos when seq == pos, a consumer may empty it when seq == pos + 1.
+// Both sides claim positions with a CAS on their own cache-line-padded
+// counter, so no lock is taken while the ring is neither full nor empty.
+// push() and pop() park on a condition variable only when they cannot make
+// progress; the other side touches the mutex only if someone is parked.
+// close() wakes everyone: push() then fails, pop() drains what is left and
+// then returns false.
+template <typename T>
+class MpmcRing
+{
+    struct alignas(64) Cell
     {
-        std::vector<std::tuple<int, int, int>> edges;
-        std::vector<int> parent(V);
-        for (int u = 0; u < V; ++u)
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // next position to pop
+    alignas(64) std::atomic<size_t> tail{0}; // next position to push
+    alignas(64) std::atomic<bool> closed{false};
+    std::atomic<int> sleepers{0};
+    std::mutex m;
+    std::condition_variable cv;
+
+    template <typename Ready>
+    void park(Ready ready)
+    {
+        for (int spin = 0; spin < 64; ++spin)
         {
-            for (int v : adj[u])
-            {
-                if (u < v)
-                    edges.emplace_back(1, u, v);
-            }
+            if (ready())
+                return;
+            std::this_thread::yield();
         }
-        std::sort(edges.begin(), edges.end());
-        std::function<int(int)> find = [&](int x)
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
         {
-            return parent[x] == x ? x : parent[x] = find(parent[x]);
-        };
-        for (int i = 0; i < V; ++i)
-            parent[i] = i;
-        int mstWeight = 0;
-        for (auto [w, u, v] : edges)
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, ready);
+        }
+        sleepers.fetch_sub(1);
+    }
+
+    void wakeSleepers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
         {
-            int ru = find(u), rv = find(v);
-            if (ru != rv)
-            {
-                mstWeight += w;
-                parent[ru] = rv;
-            }
+            std::lock_guard<std::mutex> lock(m);
+            cv.notify_all();
         }
-        return mstWeight;
     }
-    std::string MST()
+
+public:
+    explicit MpmcRing(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        cells = std::make_unique<Cell[]>(size);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    size_t size() const
     {
-        int weight = findMSTWeight();
-        return "MST weight: " + std::to_string(weight);
+        size_t t = tail.load(), h = head.load();
+        return t > h ? t - h : 0;
     }
 
-    bool isClique(const std::vector<int> &nodes)
+    // Moves item in and returns true, or returns false (item untouched) when
+    // the ring is full or closed
+    bool tryPush(T &item)
     {
-        for (size_t i = 0; i < nodes.size(); ++i)
+        if (closed.load(std::memory_order_relaxed))
+            return false;
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true)
         {
-            for (size_t j = i + 1; j < nodes.size(); ++j)
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
             {
-                int u = nodes[i], v = nodes[j];
-                if (std::find(adj[u].begin(), adj[u].end(), v) == adj[u].end())
-                    return false;
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(item);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    wakeSleepers();
+                    return true;
+                }
             }
+            else if (diff < 0)
+                return false;
+            else
+                pos = tail.load(std::memory_order_relaxed);
         }
-        return true;
     }
 
-    int countCliques()
+    // Non-blocking pop; false when the ring is empty
+    bool tryPop(T &item)
     {
-        int count = 0;
-        int total = 1 << V; // All subsets
-
-        for (int mask = 1; mask < total; ++mask)
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true)
         {
-            std::vector<int> subset;
-            for (int i = 0; i < V; ++i)
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
             {
-                if (mask & (1 << i))
-                    subset.push_back(i);
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(cell.value);
+                    cell.value = T();
+                    cell.seq.store(pos + mask + 1, std::memory_order_release);
+                    wakeSleepers();
+                    return true;
+                }
             }
-            if (isClique(subset))
-                count++;
+            else if (diff < 0)
+                return false;
+            else
+                pos = head.load(std::memory_order_relaxed);
         }
-
-        return count;
-    }
-    std::string numCliques()
-    {
-        int count = countCliques();
-        return "Number of Cliques: " + std::to_string(count);
     }
-    void fillOrder(int v, std::vector<bool> &visited, std::stack<int> &Stack)
+
+    // Blocks while the ring is full; false once it is closed
+    bool push(T item)
     {
-        visited[v] = true;
-        for (int u : adj[v])
-            if (!visited[u])
-                fillOrder(u, visited, Stack);
-        Stack.push(v);
+        while (!tryPush(item))
+        {
+            if (closed.load())
+                return false;
+            park([&] { return closed.load() || size() < capacity(); });
+        }
+        return true;
     }
 
-    Graph getTranspose()
+    // Blocks while the ring is empty; false once it is closed and drained
+    bool pop(T &item)
     {
-        Graph gT(V);
-        for (int u = 0; u < V; ++u)
-            for (int v : adj[u])
-                gT.addEdge(v, u);
-        return gT;
+        while (!tryPop(item))
+        {
+            if (closed.load() && size() == 0)
+                return false;
+            park([&] { return closed.load() || size() > 0; });
+        }
+        return true;
     }
 
-    void dfsSCCCollect(int v, std::vector<bool> &visited, std::vector<int> &component)
+    void close()
     {
-        visited[v] = true;
-        component.push_back(v);
-        for (int u : adj[v])
-            if (!visited[u])
-                dfsSCCCollect(u, visited, component);
+        closed.store(true);
+        std::lock_guard<std::mutex> lock(m);
+        cv.notify_all();
     }
+};
 
-    std::vector<std::vector<int>> findSCCGroups()
+// ================= Work-Stealing Pool =================
+// The compute stage. Every worker owns a deque: it pushes and pops its own
+// tasks at the back, and a worker that runs dry steals the oldest task from
+// the front of another's. Tasks submitted from outside the pool go to a
+// bounded injection ring; submit() blocks while it is full, which is what
+// throttles the acceptor. Idle workers sleep until `queued` is non-zero.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct WorkerQueue
     {
-        std::stack<int> Stack;
-        std::vector<bool> visited(V, false);
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
 
-        for (int i = 0; i < V; ++i)
-            if (!visited[i])
-                fillOrder(i, visited, Stack);
+    // Unfinished tasks of one runAll() batch and the first error they threw
+    struct TaskGroup
+    {
+        std::mutex m;
+        std::condition_variable done;
+        int pending;
+        std::exception_ptr error;
+    };
 
-        Graph gr = getTranspose();
-        visited.assign(V, false);
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake;
+    MpmcRing<Task> injected;
+    std::atomic<long> queued{0};
+    bool stopping = false;
 
-        std::vector<std::vector<int>> sccGroups;
+    // Index of the pool worker running on this thread, -1 outside the pool
+    static int &currentWorker()
+    {
+        thread_local int id = -1;
+        return id;
+    }
 
-        while (!Stack.empty())
+    void push(Task task)
+    {
+        int id = currentWorker();
+        if (id >= 0)
         {
-            int v = Stack.top();
-            Stack.pop();
-            if (!visited[v])
-            {
-                std::vector<int> component;
-                gr.dfsSCCCollect(v, visited, component);
-                sccGroups.push_back(component);
-            }
+            std::lock_guard<std::mutex> lock(queues[id]->m);
+            queues[id]->tasks.push_back(std::move(task));
+        }
+        else if (!injected.push(std::move(task)))
+        {
+            return;
+        }
+        queued.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(m);
         }
+        wake.notify_one();
+    }
 
-        return sccGroups;
+    bool popLocal(int id, Task &task)
+    {
+        std::lock_guard<std::mutex> lock(queues[id]->m);
+        if (queues[id]->tasks.empty())
+            return false;
+        task = std::move(queues[id]->tasks.back());
+        queues[id]->tasks.pop_back();
+        queued.fetch_sub(1);
+        return true;
     }
 
-    std::string SCC()
+    bool popInjected(Task &task)
     {
-        auto groups = findSCCGroups();
-        if (groups.empty())
+        if (!injected.tryPop(task))
+            return false;
+        queued.fetch_sub(1);
+        return true;
+    }
+
+    // Takes the oldest task of the first non-empty deque after worker id
+    bool steal(int id, Task &task)
+    {
+        int n = queues.size();
+        for (int k = 1; k < n; ++k)
         {
-            return "No Strongly Connected Components found.";
+            WorkerQueue &victim = *queues[(id + k) % n];
+            std::lock_guard<std::mutex> lock(victim.m);
+            if (victim.tasks.empty())
+                continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
         }
+        return false;
+    }
 
-        std::ostringstream oss;
-        oss << "Strongly Connected Components:\n";
-        for (size_t i = 0; i < groups.size(); ++i)
+    void loop(int id)
+    {
+        currentWorker() = id;
+        Task task;
+        while (true)
         {
-            oss << "Component " << i + 1 << ": ";
-            for (int v : groups[i])
+            if (popLocal(id, task) || popInjected(task) || steal(id, task))
             {
-                oss << v << " ";
+                task();
+                task = nullptr;
+                continue;
             }
-            oss << "\n";
+            std::unique_lock<std::mutex> lock(m);
+            wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0)
+                return;
         }
-        return oss.str();
     }
 
-    bool hamiltonUtil(int pos, std::vector<int> &path, std::vector<bool> &visited)
+public:
+    WorkStealingPool(int size, size_t injectCapacity) : injected(injectCapacity)
     {
-        if (pos == V)
-        {
-            return std::find(adj[path[pos - 1]].begin(), adj[path[pos - 1]].end(), path[0]) != adj[path[pos - 1]].end();
-        }
+        for (int id = 0; id < size; ++id)
+            queues.push_back(std::make_unique<WorkerQueue>());
+        for (int id = 0; id < size; ++id)
+            workers.emplace_back(&WorkStealingPool::loop, this, id);
+    }
 
-        for (int v = 1; v < V; ++v)
+    // Refuses new outside work, then lets the workers drain every queue
+    ~WorkStealingPool()
+    {
+        injected.close();
         {
-            if (!visited[v] && std::find(adj[path[pos - 1]].begin(), adj[path[pos - 1]].end(), v) != adj[path[pos - 1]].end())
-            {
-                path[pos] = v;
-                visited[v] = true;
-                if (hamiltonUtil(pos + 1, path, visited))
-                    return true;
-                visited[v] = false;
-            }
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
         }
-        return false;
+        wake.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+
+    int size() const { return (int)workers.size(); }
+
+    void submit(Task task)
+    {
+        push(std::move(task));
     }
 
-    std::string hamiltonianCircuit()
+    // Tasks waiting in the injection ring or a worker's deque
+    long backlog() const
     {
-        std::vector<int> path(V, -1);
-        std::vector<bool> visited(V, false);
-        path[0] = 0;
-        visited[0] = true;
+        return queued.load();
+    }
 
-        if (hamiltonUtil(1, path, visited))
+    // Runs every task of batch on the pool and returns when all have
+    // finished, rethrowing the first exception one of them threw. Called from
+    // a worker, the batch goes to its own deque and the caller keeps popping
+    // it while idle workers steal the rest; it only blocks once every task of
+    // the batch has been taken.
+    void runAll(std::vector<Task> batch)
+    {
+        TaskGroup group;
+        group.pending = batch.size();
+        for (auto &t : batch)
         {
-            std::string result = "Hamiltonian Circuit: ";
-            for (int v : path)
-                result += std::to_string(v) + " -> ";
-            result += std::to_string(path[0]); 
-            return result;
+            push([&group, t = std::move(t)]
+                 {
+                     std::exception_ptr error;
+                     try
+                     {
+                         t();
+                     }
+                     catch (...)
+                     {
+                         error = std::current_exception();
+                     }
+                     std::lock_guard<std::mutex> lock(group.m);
+                     if (error && !group.error)
+                         group.error = error;
+                     if (--group.pending == 0)
+                         group.done.notify_all();
+                 });
         }
-        else
+
+        int id = currentWorker();
+        Task task;
+        while (id >= 0 && popLocal(id, task))
         {
-            return "Graph does not have a Hamiltonian Circuit";
+            task();
+            task = nullptr;
         }
+
+        std::unique_lock<std::mutex> lock(group.m);
+        group.done.wait(lock, [&] { return group.pending == 0; });
+        if (group.error)
+            std::rethrow_exception(group.error);
     }
 };
 
-// ================= Blocking Queue Template =================
-template <typename T>
-class BlockingQueue
+// ================= Pipeline Queues =================
+const int REQUEST_INTS = 5; // V, E, seed, maxWeight, deadline ms
+const size_t REQUEST_BYTES = REQUEST_INTS * sizeof(int);
+const size_t SHORT_REQUEST_BYTES = REQUEST_BYTES - sizeof(int); // no deadline
+
+// Compute budget in milliseconds (0 for none). A request may ask for less
+// in its optional fifth int, never for more; past it the clique count and
+// the Hamiltonian search stop and the response is STATUS_PARTIAL.
+const int DEFAULT_DEADLINE_MS = 10000;
+int deadlineMs = DEFAULT_DEADLINE_MS;
+
+Deadline requestDeadline(int requestedMs)
 {
-    std::queue<T> q;
-    std::mutex mtx;
-    std::condition_variable cv;
+    if (requestedMs > 0 && (deadlineMs <= 0 || requestedMs < deadlineMs))
+        return Deadline::in(requestedMs);
+    return Deadline::in(deadlineMs);
+}
 
-public:
-    void push(T item)
-    {
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            q.push(std::move(item));
-        }
-        cv.notify_one();
-    }
+// Admission by estimated cost (roughly 1e8 steps a second, as in Ex7): a
+// request whose five results are estimated above maxCost is answered with
+// a rejection instead of being run
+const double DEFAULT_MAX_COST = 1e11;
+double maxCost = DEFAULT_MAX_COST;
 
-    T pop()
+// Expected number of cliques in a uniform random graph with V vertices
+// and E edges: the sum over k of C(V, k) * p^(k(k-1)/2). The terms rise
+// then fall, so the sum stops at the first term below one past k = 2.
+double expectedCliques(int V, int E)
+{
+    double pairs = (double)V * (V - 1) / 2;
+    if (V <= 0 || E <= 0 || pairs <= 0)
+        return std::max(V, 0);
+    double logP = std::log(std::min(1.0, E / pairs));
+    // log C(V, k) is built up a factor at a time: std::lgamma writes the
+    // global signgam, and the estimate runs on several threads at once
+    double total = 0, logChoose = 0;
+    for (int k = 1; k <= V; ++k)
     {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [&]
-                { return !q.empty() || stopServer; });
-        if (q.empty())
-            return T(); 
-        T item = std::move(q.front());
-        q.pop();
-        return item;
+        logChoose += std::log((double)(V - k + 1) / k);
+        double term = std::exp(logChoose + k * (k - 1) / 2.0 * logP);
+        total += term;
+        if (term < 1 && k > 2)
+            break;
     }
-};
+    return total;
+}
+
+// Rough step count for all five results on a generated graph with V
+// vertices and E edges. The clique count and the Hamiltonian search
+// dominate: every clique is visited once, Held-Karp costs V * 2^(V-2), and
+// the pruned backtracking above it is taken as V * E.
+double estimateCost(int V, int E)
+{
+    double n = std::max(V, 1), m = std::max(E, 1);
+    double hamilton = V <= Graph::heldKarpMaxV() ? std::ldexp(n, std::max(V - 2, 0)) : n * m;
+    return n + m + m * std::log2(m + 1) + expectedCliques(V, E) + hamilton;
+}
+
+// The answer to a request whose estimated cost is over maxCost
+std::string rejection(double cost)
+{
+    char text[96];
+    snprintf(text, sizeof(text), "Rejected: estimated cost %.3g exceeds the limit %.3g", cost, maxCost);
+    return text;
+}
 
-// ================= Pipeline Queues =================
 struct ClientData
 {
     int socket;
-    sockaddr_in addr;
+    uint32_t requestId;
+    bool binary; // OP_ALGORITHMS_BINARY
+    int request[REQUEST_INTS];
+    Metrics::Clock::time_point received;
 };
 
+// A response for the writer, or (finalCount >= 0) the acceptor's note that
+// the connection has ended after finalCount requests; the writer closes the
+// socket once that many responses are out
 struct ProcessedData
 {
     int socket;
-    std::string result;
+    uint32_t requestId = 0;
+    uint32_t status = STATUS_OK;
+    ResponseBuffer result;
+    int finalCount = -1;
 };
 
-BlockingQueue<ClientData> readQueue;
-BlockingQueue<ProcessedData> writeQueue;
+WorkStealingPool *computePool;
+// Bounded stage queues: a full queue stalls the stage that feeds it
+const size_t REQUEST_QUEUE_CAPACITY = 1024;
+const size_t RESULT_QUEUE_CAPACITY = 1024;
 
-// ================= Stage 1: Accept Connections =================
-void acceptorThread()
+MpmcRing<ProcessedData> writeQueue(RESULT_QUEUE_CAPACITY);
+// Wakes the writer's epoll loop when writeQueue gets a new result
+int writerWakeFd;
+
+void deliver(ProcessedData pd)
 {
-    while (!stopServer)
-    {
-        sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
-        int client_socket = accept(server_fd, (sockaddr *)&client_addr, &client_len);
-        if (client_socket < 0)
-            continue;
-        readQueue.push({client_socket, client_addr});
-    }
+    writeQueue.push(std::move(pd));
+    uint64_t one = 1;
+    if (write(writerWakeFd, &one, sizeof(one)) < 0)
+        perror("eventfd write failed");
 }
 
-// ================= Stage 2: Read Data =================
-void readerThread()
+// The OP_STATS answer: stage metrics, then cache and queue state
+ResponseBuffer statsText()
 {
-    while (!stopServer)
+    ResponseBuffer out;
+    metrics.write(out);
+    out << "# HELP graph_cache_hits_total Cache lookups that found an entry\n"
+        << "# TYPE graph_cache_hits_total counter\n"
+        << "graph_cache_hits_total{cache=\"graph\"} " << graphCache.hits() << '\n'
+        << "graph_cache_hits_total{cache=\"result\"} " << resultCache.hits() << '\n'
+        << "# HELP graph_cache_misses_total Cache lookups that found none\n"
+        << "# TYPE graph_cache_misses_total counter\n"
+        << "graph_cache_misses_total{cache=\"graph\"} " << graphCache.misses() << '\n'
+        << "graph_cache_misses_total{cache=\"result\"} " << resultCache.misses() << '\n'
+        << "# HELP graph_queue_depth Items waiting between pipeline stages\n"
+        << "# TYPE graph_queue_depth gauge\n"
+        << "graph_queue_depth{queue=\"compute\"} " << computePool->backlog() << '\n'
+        << "graph_queue_depth{queue=\"write\"} " << writeQueue.size() << '\n';
+    return out;
+}
+
+void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+void watch(int epollFd, int fd, uint32_t events)
+{
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void computeRequest(const ClientData &client);
+
+// ================= Stage 1: Accept Connections and Read Requests =================
+// Edge-triggered epoll loop over the listening socket and every non-blocking
+// client socket. Bytes collect in a per-connection buffer; every complete
+// frame goes to the compute pool while the connection stays here for the
+// next one. On EOF or a malformed frame the socket leaves this loop and the
+// writer closes it after the last response.
+void acceptorThread()
+{
+    struct Inbound
     {
-        ClientData client = readQueue.pop();
-        if (client.socket == 0)
-            continue;
+        std::string in;
+        int submitted = 0;
+    };
 
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client.addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-        std::cout << "Client connected from " << client_ip << ":" << ntohs(client.addr.sin_port) << "\n";
+    int epollFd = epoll_create1(0);
+    watch(epollFd, server_fd, EPOLLIN | EPOLLET);
+    std::unordered_map<int, Inbound> connections;
+    epoll_event events[64];
 
-        try
+    while (!stopServer)
+    {
+        int n = epoll_wait(epollFd, events, 64, -1);
+        for (int i = 0; i < n; ++i)
         {
-            int data[3]; // V, E, seed 
-            ssize_t bytesRead = read(client.socket, data, sizeof(data));
-            if (bytesRead != sizeof(data))
+            int fd = events[i].data.fd;
+            if (fd == server_fd)
             {
-                std::cout << "Invalid request or client disconnected.\n";
-                close(client.socket);
+                while (true)
+                {
+                    auto start = Metrics::Clock::now();
+                    sockaddr_in client_addr{};
+                    socklen_t client_len = sizeof(client_addr);
+                    int client_socket = accept(server_fd, (sockaddr *)&client_addr, &client_len);
+                    if (client_socket < 0)
+                    {
+                        if (errno == EINTR || errno == ECONNABORTED)
+                            continue;
+                        break;
+                    }
+                    setNonBlocking(client_socket);
+
+                    char client_ip[INET_ADDRSTRLEN];
+                    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+                    std::cout << "Client connected from " << client_ip << ":" << ntohs(client_addr.sin_port) << "\n";
+
+                    connections[client_socket] = Inbound();
+                    watch(epollFd, client_socket, EPOLLIN | EPOLLRDHUP | EPOLLET);
+                    metrics.record(STAGE_ACCEPT, Metrics::Clock::now() - start);
+                }
                 continue;
             }
 
-            int V = data[0], E = data[1], seed = data[2];
-            Graph g(V);
-            std::set<std::pair<int, int>> existing;
-            std::mt19937 rng(seed);
-            std::uniform_int_distribution<int> dist(0, V - 1);
-
-            while ((int)existing.size() < E)
+            Inbound &conn = connections[fd];
+            std::string &in = conn.in;
+            bool closed = (events[i].events & EPOLLERR) != 0;
+            char buf[4096];
+            auto readStart = Metrics::Clock::now();
+            while (!closed)
             {
-                int u = dist(rng);
-                int v = dist(rng);
-                if (u == v)
+                ssize_t bytesRead = read(fd, buf, sizeof(buf));
+                if (bytesRead > 0)
+                    in.append(buf, bytesRead);
+                else if (bytesRead < 0 && errno == EINTR)
                     continue;
-                auto edge = std::minmax(u, v);
-                if (!existing.count(edge))
+                else
+                {
+                    closed = bytesRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                    break;
+                }
+            }
+            metrics.record(STAGE_READ, Metrics::Clock::now() - readStart);
+
+            size_t used = 0;
+            FrameHeader header;
+            const char *payload;
+            size_t payloadBytes;
+            int parsed;
+            while ((parsed = parseFrame(in, used, header, payload, payloadBytes, MAX_REQUEST_FRAME)) > 0)
+            {
+                bool known = header.code == OP_ALGORITHMS || header.code == OP_ALGORITHMS_BINARY;
+                if (known && (payloadBytes == REQUEST_BYTES || payloadBytes == SHORT_REQUEST_BYTES))
+                {
+                    ClientData client{fd, header.requestId, header.code == OP_ALGORITHMS_BINARY, {},
+                                      Metrics::Clock::now()};
+                    memcpy(client.request, payload, payloadBytes);
+                    double cost = estimateCost(client.request[0], client.request[1]);
+                    if (cost <= maxCost)
+                        computePool->submit([client] { computeRequest(client); });
+                    else
+                    {
+                        // Turned away here, so it never takes a compute thread
+                        ProcessedData pd;
+                        pd.socket = fd;
+                        pd.requestId = header.requestId;
+                        pd.status = STATUS_ERROR;
+                        pd.result = ResponseBuffer(rejection(cost));
+                        metrics.requestDone(STATUS_ERROR);
+                        deliver(std::move(pd));
+                    }
+                }
+                else
                 {
-                    g.addEdge(edge.first, edge.second);
-                    existing.insert(edge);
+                    // Stats are cheap enough to answer without the pool
+                    ProcessedData pd;
+                    pd.socket = fd;
+                    pd.requestId = header.requestId;
+                    if (header.code == OP_STATS && payloadBytes == 0)
+                        pd.result = statsText();
+                    else
+                    {
+                        pd.status = STATUS_ERROR;
+                        pd.result = "Unknown opcode or malformed request";
+                        metrics.requestDone(STATUS_ERROR);
+                    }
+                    deliver(std::move(pd));
                 }
+                ++conn.submitted;
+            }
+            if (parsed < 0)
+            {
+                std::cout << "Invalid request frame.\n";
+                closed = true;
             }
+            in.erase(0, used);
 
-            std::ostringstream oss;
-            oss << g.eulerianCircuit() << "\n";
-            oss << g.MST() << "\n";
-            oss << g.numCliques() << "\n";
-            oss << g.SCC();
-            oss << g.hamiltonianCircuit() << "\n";
+            if (closed)
+            {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                ProcessedData end;
+                end.socket = fd;
+                end.finalCount = conn.submitted;
+                connections.erase(fd);
+                deliver(std::move(end));
+            }
+        }
+    }
+    close(epollFd);
+}
 
-            writeQueue.push({client.socket, oss.str()});
+// ================= Stage 2: Compute =================
+// Runs on a pool worker: takes what it can from the result cache, then the
+// missing algorithms run as parallel tasks over the (possibly cached) graph.
+// Graph is read-only after freeze() and keeps its scratch buffers per
+// thread, so the tasks share g without locking.
+void computeRequest(const ClientData &client)
+{
+    metrics.record(STAGE_QUEUE, Metrics::Clock::now() - client.received);
+    ProcessedData pd;
+    pd.socket = client.socket;
+    pd.requestId = client.requestId;
+    try
+    {
+        const int *r = client.request;
+        bool binary = client.binary;
+        Deadline deadline = requestDeadline(r[4]);
+        ResponseBuffer parts[ALGO_COUNT];
+        bool complete[ALGO_COUNT] = {true, true, true, true, true};
+        std::shared_ptr<Graph> g;
+        std::vector<WorkStealingPool::Task> missing;
+        for (int algorithm = 0; algorithm < ALGO_COUNT; ++algorithm)
+        {
+            ResultKey key{r[0], r[1], r[2], r[3], algorithm, binary};
+            if (!cachedResult(key, parts[algorithm]))
+                missing.push_back([&, key] { complete[key[4]] = computeResult(*g, key, parts[key[4]], deadline); });
         }
-        catch (const std::exception &e)
+        if (!missing.empty())
         {
-            std::cerr << "Error: " << e.what() << "\n";
+            g = cachedGraph({r[0], r[1], r[2], r[3]});
+            computePool->runAll(std::move(missing));
         }
+        if (!std::all_of(complete, complete + ALGO_COUNT, [](bool c) { return c; }))
+            pd.status = STATUS_PARTIAL;
+
+        StageTimer timer(metrics, STAGE_SERIALIZE);
+        joinResults(pd.result, parts, complete, binary);
     }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        pd.status = STATUS_ERROR;
+        pd.result = ResponseBuffer(e.what());
+    }
+    metrics.requestDone(pd.status);
+    deliver(std::move(pd));
 }
 
 // ================= Stage 3: Write Result =================
+// Epoll loop over the wake-up eventfd and the sockets whose responses did not
+// fit in the socket buffer at once. A connection is closed here, and only
+// here, once the acceptor has let go of it and all its responses are out.
 void writerThread()
 {
+    struct Outgoing
+    {
+        FrameQueue frames;
+        int answered = 0;
+        int expected = -1; // response count, known once the acceptor is done
+        bool watched = false;
+        bool broken = false; // a write failed; remaining output is dropped
+    };
+
+    int epollFd = epoll_create1(0);
+    watch(epollFd, writerWakeFd, EPOLLIN | EPOLLET);
+    std::unordered_map<int, Outgoing> pending;
+    epoll_event events[64];
+
+    // Writes until the buffer is empty or the socket would block, then
+    // closes the connection if nothing more is coming
+    auto flush = [&](int fd)
+    {
+        Outgoing &out = pending[fd];
+        if (!out.broken)
+        {
+            StageTimer timer(metrics, STAGE_WRITE);
+            if (!out.frames.flush(fd))
+            {
+                out.broken = true;
+                out.frames = FrameQueue();
+            }
+        }
+        if (!out.frames.empty())
+        {
+            if (!out.watched)
+                watch(epollFd, fd, EPOLLOUT | EPOLLET);
+            out.watched = true;
+            return;
+        }
+        if (out.answered == out.expected)
+        {
+            pending.erase(fd);
+            close(fd);
+            printCacheStats();
+        }
+    };
+
     while (!stopServer)
     {
-        ProcessedData pd = writeQueue.pop();
-        if (pd.socket == 0)
-            continue;
+        int n = epoll_wait(epollFd, events, 64, -1);
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd != writerWakeFd)
+            {
+                if (pending.count(fd))
+                    flush(fd);
+                continue;
+            }
 
-        int len = pd.result.size();
-        write(pd.socket, &len, sizeof(len));
-        write(pd.socket, pd.result.c_str(), len);
+            uint64_t count;
+            while (read(writerWakeFd, &count, sizeof(count)) > 0)
+                ;
+            ProcessedData pd;
+            while (writeQueue.tryPop(pd))
+            {
+                Outgoing &out = pending[pd.socket];
+                if (pd.finalCount >= 0)
+                {
+                    out.expected = pd.finalCount;
+                }
+                else
+                {
+                    ++out.answered;
+                    if (!out.broken)
+                        out.frames.push(pd.requestId, pd.status, std::move(pd.result));
+                }
+                flush(pd.socket);
+            }
+        }
     }
+    close(epollFd);
 }
 
 // ================= Main =================
-int main()
+// bench.cpp builds this file with GRAPH_BENCH defined to reuse all of it
+// but main()
+#ifndef GRAPH_BENCH
+int main(int argc, char *argv[])
 {
+    int option;
+    int computeThreads = std::max(1u, std::thread::hardware_concurrency());
+    while ((option = getopt(argc, argv, "p:c:d:l:")) != -1)
+    {
+        switch (option)
+        {
+        case 'p':
+            Graph::parallelThreads() = std::max(1, std::stoi(optarg));
+            break;
+        case 'c':
+            computeThreads = std::max(1, std::stoi(optarg));
+            break;
+        case 'd':
+            deadlineMs = std::max(0, std::stoi(optarg));
+            break;
+        case 'l':
+            maxCost = atof(optarg);
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0]
+                      << " [-p <threads>] [-c <compute threads>] [-d <deadline ms>] [-l <max cost>]\n";
+            return 1;
+        }
+    }
+
     struct sockaddr_in address{};
     server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd == 0)
@@ -464,22 +2419,26 @@ int main()
         perror("Bind failed");
         exit(EXIT_FAILURE);
     }
-    if (listen(server_fd, 10) < 0)
+    if (listen(server_fd, SOMAXCONN) < 0)
     {
         perror("Listen failed");
         exit(EXIT_FAILURE);
     }
+    setNonBlocking(server_fd);
+    writerWakeFd = eventfd(0, EFD_NONBLOCK);
 
     std::cout << "Server listening on port 8080...\n";
 
+    WorkStealingPool pool(computeThreads, REQUEST_QUEUE_CAPACITY);
+    computePool = &pool;
+
     std::thread t1(acceptorThread);
-    std::thread t2(readerThread);
     std::thread t3(writerThread);
 
     t1.join();
-    t2.join();
     t3.join();
 
     close(server_fd);
     return 0;
 }
+#endif